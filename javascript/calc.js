@@ -310,6 +310,12 @@ if (typeof outlet === "function") {
         evaluate_expression(parts.join(" "));
     }
 
+    // With @tokenize 1 a cell that starts with a number leaves [route
+    // execute] as a list.
+    function list() {
+        evaluate_expression(arrayfromargs(arguments).join(" "));
+    }
+
     function evaluate(/* ... */) {
         evaluate_expression(arrayfromargs(arguments).join(" "));
     }
@@ -7,7 +7,8 @@
 # a dependency silently reverts it. Run this after any such refresh.
 #
 # Each patch is idempotent: if it is already applied, the patch is skipped
-# rather than reported as a failure.
+# rather than reported as a failure. That holds for patches that build on one
+# another, too; see apply_series.
 
 set -eu
 
@@ -15,43 +16,81 @@ PATCH_DIR=$(cd "$(dirname "$0")" && pwd)
 ROOT=$(cd "$PATCH_DIR/.." && pwd)
 THIRDPARTY="$ROOT/source/projects/kernel/thirdparty"
 
-apply_one() {
-    patch_file="$1"
-    target_dir="$2"
+# Apply a series of patches to one tree, in order.
+#
+# Later patches in a series can rewrite lines an earlier one added, and then
+# the earlier patch no longer reverse-applies on its own. So whether each
+# patch is already applied is judged on a scratch copy of the tree, backing
+# the series out newest first.
+apply_series() {
+    target_dir="$1"
+    shift
 
     if [ ! -d "$target_dir" ]; then
-        echo "skip $(basename "$patch_file"): $target_dir not present"
+        for patch_file in "$@"; do
+            echo "skip $(basename "$patch_file"): $target_dir not present"
+        done
         return 0
     fi
 
-    if patch -d "$target_dir" -p1 --dry-run --force --silent < "$patch_file" >/dev/null 2>&1; then
-        patch -d "$target_dir" -p1 --force --silent < "$patch_file"
-        echo "applied $(basename "$patch_file")"
-        return 0
-    fi
+    scratch=$(mktemp -d)
+    cp -R "$target_dir/." "$scratch"
 
-    if patch -d "$target_dir" -p1 -R --dry-run --force --silent < "$patch_file" >/dev/null 2>&1; then
-        echo "already applied $(basename "$patch_file")"
-        return 0
-    fi
+    newest_first=""
+    for patch_file in "$@"; do
+        newest_first="$patch_file $newest_first"
+    done
 
-    echo "FAILED $(basename "$patch_file"): does not apply to $target_dir" >&2
-    echo "The vendored source has diverged. Re-derive the patch by hand." >&2
-    return 1
-}
+    applied=""
+    for patch_file in $newest_first; do
+        if patch -d "$scratch" -p1 -R --dry-run --force --silent < "$patch_file" >/dev/null 2>&1; then
+            patch -d "$scratch" -p1 -R --force --silent < "$patch_file" >/dev/null
+            applied="$applied $patch_file "
+        fi
+    done
+    rm -rf "$scratch"
 
-status=0
+    result=0
+    for patch_file in "$@"; do
+        case "$applied" in
+        *" $patch_file "*)
+            echo "already applied $(basename "$patch_file")"
+            continue
+            ;;
+        esac
 
-apply_one "$PATCH_DIR/xeus-zmq-0001-iopub-welcome-parent-header.patch" \
-          "$THIRDPARTY/xeus-zmq" || status=1
+        if patch -d "$target_dir" -p1 --dry-run --force --silent < "$patch_file" >/dev/null 2>&1; then
+            patch -d "$target_dir" -p1 --force --silent < "$patch_file"
+            echo "applied $(basename "$patch_file")"
+            continue
+        fi
 
-apply_one "$PATCH_DIR/xeus-zmq-0002-cmake-policy-range.patch" \
-          "$THIRDPARTY/xeus-zmq" || status=1
+        echo "FAILED $(basename "$patch_file"): does not apply to $target_dir" >&2
+        echo "The vendored source has diverged. Re-derive the patch by hand." >&2
+        result=1
+    done
+    return $result
+}
+
+status=0
 
-apply_one "$PATCH_DIR/xeus-zmq-0003-timed-poll-and-idle-callback.patch" \
-          "$THIRDPARTY/xeus-zmq" || status=1
+apply_series "$THIRDPARTY/xeus-zmq" \
+    "$PATCH_DIR/xeus-zmq-0001-iopub-welcome-parent-header.patch" \
+    "$PATCH_DIR/xeus-zmq-0002-cmake-policy-range.patch" \
+    "$PATCH_DIR/xeus-zmq-0003-timed-poll-and-idle-callback.patch" \
+    "$PATCH_DIR/xeus-zmq-0004-server-wakeup.patch" \
+    "$PATCH_DIR/xeus-zmq-0006-zero-copy-frames.patch" \
+    "$PATCH_DIR/xeus-zmq-0007-verify-before-parse.patch" \
+    "$PATCH_DIR/xeus-zmq-0008-pooled-hmac-contexts.patch" \
+    "$PATCH_DIR/xeus-zmq-0009-lazy-message-parts.patch" \
+    "$PATCH_DIR/xeus-zmq-0010-send-raw-parts.patch" || status=1
 
-apply_one "$PATCH_DIR/xeus-0002-cmake-policy-range.patch" \
-          "$THIRDPARTY/xeus" || status=1
+apply_series "$THIRDPARTY/xeus" \
+    "$PATCH_DIR/xeus-0002-cmake-policy-range.patch" \
+    "$PATCH_DIR/xeus-0005-execution-result-buffers.patch" \
+    "$PATCH_DIR/xeus-0009-lazy-message-parts.patch" \
+    "$PATCH_DIR/xeus-0010-header-factory.patch" \
+    "$PATCH_DIR/xeus-0011-status-fast-path.patch" \
+    "$PATCH_DIR/xeus-0012-shared-parent-header.patch" || status=1
 
 exit $status
@@ -0,0 +1,205 @@
+#include "atom_text.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <locale>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "nlohmann/json.hpp"
+
+namespace mx {
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// True if [first, last) is a base-10 integer, optionally negative, that fits
+// in a long.
+bool parse_long(const char* first, const char* last, long& out) {
+    const auto result = std::from_chars(first, last, out);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+// Reads a number the exact fast path cannot, in the classic locale. Only for
+// text already known to be a number.
+bool parse_double_slow(const char* first, const char* last, double& out) {
+    std::istringstream in(std::string(first, last));
+    in.imbue(std::locale::classic());
+    in >> out;
+    return !in.fail() && in.peek() == std::char_traits<char>::eof();
+}
+
+// True if [first, last) is a number in decimal or exponent notation: an
+// optional '-', digits with at most one point among or around them, and an
+// optional exponent. Not "inf" or "nan", which Max reads as symbols, and not
+// a leading '+'.
+//
+// Floating-point from_chars is missing from libc++ below macOS 13.3, under the
+// deployment target the Max SDK pins, so nothing here relies on it. When the
+// significant digits, read as an integer, are at most 2^53 and the decimal
+// exponent is within 22, the value is one multiplication or division of two
+// exactly representable doubles, so correctly rounded -- every number a patch
+// is likely to contain. Anything else goes through a classic-locale stream.
+bool parse_double(const char* first, const char* last, double& out) {
+    // 10^0 to 10^22, all exactly representable.
+    static constexpr double k_powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                          1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                          1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p = first;
+    const bool negative = p != last && *p == '-';
+    if (negative) ++p;
+
+    std::uint64_t mantissa = 0;
+    int significant = 0; // digits in mantissa, not counting leading zeros
+    int exponent = 0;
+    int digits = 0;
+    bool seen_point = false;
+    for (; p != last; ++p) {
+        if (is_digit(*p)) {
+            ++digits;
+            if (significant < 19) {
+                if (mantissa != 0 || *p != '0') {
+                    mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+                    ++significant;
+                }
+                if (seen_point) --exponent;
+            } else {
+                // Digits past what the mantissa holds: only the slow path
+                // reads them correctly.
+                significant = 20;
+            }
+        } else if (*p == '.' && !seen_point) {
+            seen_point = true;
+        } else {
+            break;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+
+    if (p != last && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negative_exponent = false;
+        if (p != last && (*p == '-' || *p == '+')) {
+            negative_exponent = *p == '-';
+            ++p;
+        }
+        if (p == last) {
+            return false;
+        }
+        int written = 0;
+        for (; p != last && is_digit(*p); ++p) {
+            if (written < 10000) written = written * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -written : written;
+    }
+    if (p != last) {
+        return false;
+    }
+
+    if (significant <= 19 && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22
+        && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / k_powers[-exponent] : value * k_powers[exponent];
+        out = negative ? -value : value;
+        return true;
+    }
+    // A stream may flush an underflow to zero; keep such text a symbol, as it
+    // would be for an overflow.
+    return parse_double_slow(first, last, out) && (out != 0.0 || significant == 0);
+}
+
+// Calls emit with a long, a double or a std::string_view for each token.
+template <typename Emit>
+void tokenize(const std::string& text, Emit&& emit) {
+    const char* p = text.data();
+    const char* const end = p + text.size();
+
+    while (p != end) {
+        while (p != end && is_space(*p)) ++p;
+        if (p == end) break;
+
+        const char* const first = p;
+        while (p != end && !is_space(*p)) ++p;
+
+        long l = 0;
+        double d = 0.0;
+        if (parse_long(first, p, l)) {
+            emit(l);
+        } else if (parse_double(first, p, d)) {
+            emit(d);
+        } else {
+            emit(std::string_view(first, static_cast<size_t>(p - first)));
+        }
+    }
+}
+
+} // namespace
+
+void atom_text_writer::separate() {
+    if (!m_first) {
+        m_out.push_back(' ');
+    }
+    m_first = false;
+}
+
+void atom_text_writer::symbol(std::string_view text) {
+    separate();
+    m_out.append(text.data(), text.size());
+}
+
+void atom_text_writer::integer(long long value) {
+    separate();
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_out.append(buffer, result.ptr);
+}
+
+void append_shortest(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out.append(std::isnan(value) ? "nan" : (value < 0 ? "-inf" : "inf"));
+        return;
+    }
+    // nlohmann's Grisu2, which the vendored JSON library already carries:
+    // the same text on every platform, where floating-point std::to_chars is
+    // missing from the libc++ the Max SDK targets on macOS. It writes "2.0"
+    // for an integral value; the point is dropped, as a stream would.
+    char buffer[64];
+    char* end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), value);
+    if (end - buffer >= 2 && end[-2] == '.' && end[-1] == '0') {
+        end -= 2;
+    }
+    out.append(buffer, end);
+}
+
+void atom_text_writer::real(double value) {
+    separate();
+    append_shortest(m_out, value);
+}
+
+void tokenize_into(const std::string& text, OutletMessage& out) {
+    tokenize(text, [&out](auto token) {
+        using T = decltype(token);
+        if constexpr (std::is_same_v<T, long>) {
+            out.add_long(token);
+        } else if constexpr (std::is_same_v<T, double>) {
+            out.add_double(token);
+        } else {
+            out.add_symbol(token);
+        }
+    });
+}
+
+} // namespace mx
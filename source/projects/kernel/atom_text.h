@@ -0,0 +1,58 @@
+#pragma once
+
+// Conversions between text and atoms, shared by the interpreter and the
+// external. Max-free, so they are tested on their own.
+
+#include <string>
+#include <string_view>
+
+#include "outlet_message.h"
+
+namespace mx {
+
+// Split text into atoms the way a Max message box would read it: on
+// whitespace, with a token that is entirely an integer becoming a long, one
+// that is entirely a decimal or exponent number a double, and anything else
+// a symbol. Quotes and backslashes are not interpreted, and commas and
+// semicolons are ordinary characters. Appends to `out`.
+void tokenize_into(const std::string& text, OutletMessage& out);
+
+// Appends text that reads back as `value`, in plain or exponent notation,
+// independent of locale. It is the shortest such text but in rare cases, where
+// it can be a digit longer (1e23 comes out as 9.999999999999999e+22), as it
+// does from nl::json::dump. Shared with json_writer.
+void append_shortest(std::string& out, double value);
+
+// Writes atoms as text onto the end of a string, separated by single spaces.
+// Numbers are written without a locale and with no allocation beyond the
+// string's own: integers with std::to_chars, doubles in the shortest form that
+// reads back as the same value (0.1, not 0.100000; 3.14159265, not 3.14159),
+// the same on every platform. A double with an integral value prints without
+// a point, as it did through a stream.
+class atom_text_writer {
+public:
+    explicit atom_text_writer(std::string& out) : m_out(out) {}
+
+    void symbol(std::string_view text);
+    void integer(long long value);
+    void real(double value);
+
+private:
+    void separate();
+
+    std::string& m_out;
+    bool m_first = true;
+};
+
+// Formats [first, last) with `read(atom, writer)`, which writes each atom it
+// understands and skips the rest. This is how the external joins t_atoms
+// without the formatter knowing about Max.
+template <typename Atom, typename Read>
+void format_atoms(std::string& out, const Atom* first, const Atom* last, Read&& read) {
+    atom_text_writer writer(out);
+    for (; first != last; ++first) {
+        read(*first, writer);
+    }
+}
+
+} // namespace mx
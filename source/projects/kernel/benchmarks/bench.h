@@ -0,0 +1,58 @@
+#pragma once
+
+// Minimal timing helpers shared by the benchmarks.
+//
+// These are not a statistics framework. Each benchmark runs its workload a few
+// times and reports the best run, which is the number least disturbed by
+// whatever else the machine is doing. Compare figures from the same build on
+// the same machine; absolute values mean little across either.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace mx {
+namespace bench {
+
+// Repetitions per measurement. The best of these is reported.
+constexpr int k_runs = 5;
+
+// Seconds taken by the fastest of k_runs calls to fn.
+template <typename F>
+double best_of(F&& fn) {
+    double best = 1e300;
+    for (int i = 0; i < k_runs; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+inline void title(const std::string& text) {
+    std::printf("\n%s\n", text.c_str());
+    std::printf("%s\n", std::string(text.size(), '-').c_str());
+}
+
+// One result line: "<label>  <rate> <unit>/s  (<extra>)".
+inline void report(const std::string& label, double count, double seconds,
+                   const char* unit, const std::string& extra = "") {
+    std::printf("  %-36s %14.0f %s/s", label.c_str(), count / seconds, unit);
+    if (!extra.empty()) {
+        std::printf("  (%s)", extra.c_str());
+    }
+    std::printf("\n");
+}
+
+// Keeps the optimiser from discarding a result nothing else reads.
+template <typename T>
+inline void keep(T const& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+} // namespace bench
+} // namespace mx
@@ -0,0 +1,113 @@
+// Formatting a `print` or `result` argument list: std::stringstream, as
+// atoms_to_string used to, against atom_text_writer.
+//
+// Each iteration joins one list of fake t_atoms into a fresh string, as the
+// external does per message on Max's main thread. Three lists: a row of
+// sensor-like floats, a row of ints and a short mixed message.
+//
+// The stream's figure flatters it: at its default precision it writes six
+// significant digits, so the floats it produces are shorter and wrong.
+
+#include "bench.h"
+
+#include "../atom_text.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr long k_lists = 200000;
+
+// Stands in for t_atom.
+struct fake_atom {
+    int type; // 1 = long, 2 = double, 3 = symbol
+    union {
+        long l;
+        double d;
+        const char* s;
+    };
+};
+
+fake_atom make_long(long v) { fake_atom a; a.type = 1; a.l = v; return a; }
+fake_atom make_double(double v) { fake_atom a; a.type = 2; a.d = v; return a; }
+fake_atom make_symbol(const char* v) { fake_atom a; a.type = 3; a.s = v; return a; }
+
+std::string with_stream(const std::vector<fake_atom>& atoms) {
+    std::stringstream ss;
+    bool first = true;
+    for (const fake_atom& a : atoms) {
+        if (!first) ss << " ";
+        first = false;
+        if (a.type == 3) {
+            ss << a.s;
+        } else if (a.type == 1) {
+            ss << a.l;
+        } else {
+            ss << a.d;
+        }
+    }
+    return ss.str();
+}
+
+std::string with_writer(const std::vector<fake_atom>& atoms) {
+    std::string text;
+    text.reserve(atoms.size() * 12);
+    mx::format_atoms(text, atoms.data(), atoms.data() + atoms.size(),
+                     [](const fake_atom& a, mx::atom_text_writer& writer) {
+        if (a.type == 3) {
+            writer.symbol(a.s);
+        } else if (a.type == 1) {
+            writer.integer(a.l);
+        } else {
+            writer.real(a.d);
+        }
+    });
+    return text;
+}
+
+template <typename Format>
+void run(const char* label, const std::vector<fake_atom>& atoms, Format format) {
+    size_t bytes = 0;
+    const double seconds = mx::bench::best_of([&] {
+        bytes = 0;
+        for (long i = 0; i < k_lists; ++i) {
+            const std::string text = format(atoms);
+            bytes += text.size();
+            mx::bench::keep(text);
+        }
+    });
+    mx::bench::report(label, k_lists, seconds, "lists",
+                      std::to_string(bytes / k_lists) + " bytes/list");
+}
+
+void compare(const std::string& name, const std::vector<fake_atom>& atoms) {
+    mx::bench::title(name + ", " + std::to_string(atoms.size()) + " atoms x "
+                     + std::to_string(k_lists));
+    run("stringstream", atoms, with_stream);
+    run("atom_text_writer (to_chars)", atoms, with_writer);
+}
+
+} // namespace
+
+int main() {
+    std::vector<fake_atom> floats;
+    for (int i = 0; i < 16; ++i) {
+        floats.push_back(make_double(0.1 * i + 1.0 / (i + 3)));
+    }
+
+    std::vector<fake_atom> ints;
+    for (int i = 0; i < 16; ++i) {
+        ints.push_back(make_long(i * 7919 - 40000));
+    }
+
+    const std::vector<fake_atom> mixed{make_symbol("freq"), make_double(440.0),
+                                       make_symbol("amp"), make_double(0.25),
+                                       make_long(3)};
+
+    compare("floats", floats);
+    compare("ints", ints);
+    compare("mixed", mixed);
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Receiving small control messages -- kernel_info_request, is_complete_request
+// and comm_msg -- as a programmatic client sends them in bulk. Each message is
+// verified, deserialized, and has its header read as dispatch reads it, and
+// its content if its handler reads that. All four parts parsed up front and
+// the header copied, as before patch 0009, against parts parsed on first
+// access and the header shared.
+//
+// Needs libzmq and OpenSSL, like the tests, because it drives xeus-zmq's own
+// serializer. Building each wire message is outside the timed region.
+
+#include "bench.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_messages = 30000;
+
+struct request {
+    const char* msg_type;
+    const char* content;
+    bool reads_content;
+};
+
+const request k_requests[] = {
+    {"kernel_info_request", "{}", false},
+    {"is_complete_request", R"({"code":"metro 100"})", true},
+    {"comm_msg", R"({"comm_id":"0b7c3e2a9f8d4c61a5e3b2d1c0f9e8d7","data":{"method":"update","state":{"value":0.5}}})", true},
+};
+
+xeus::xraw_buffer raw(const std::string& s) {
+    return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+// Frames as jupyter_client sends them: an empty parent header and metadata.
+std::vector<std::string> frames_of(const request& r, int i, const xeus::xauthentication& auth) {
+    const std::string header =
+        R"({"msg_id":"6f1c2b9e-0d3a-4e7b-8c5f-)" + std::to_string(100000000000 + i)
+        + R"(","msg_type":")" + r.msg_type
+        + R"(","session":"b2d8c0f4-4e1c-47b6-8a53-9c1d1b8e7f22","username":"user",)"
+          R"("date":"2026-10-17T12:00:00.000000Z","version":"5.3"})";
+    std::vector<std::string> frames = {"client", "<IDS|MSG>", "", header, "{}", "{}", r.content};
+    frames[2] = auth.sign(raw(frames[3]), raw(frames[4]), raw(frames[5]), raw(frames[6]));
+    return frames;
+}
+
+std::vector<zmq::multipart_t> make_wires(const xeus::xauthentication& auth) {
+    std::vector<zmq::multipart_t> wires(k_messages);
+    for (int i = 0; i < k_messages; ++i) {
+        for (const std::string& f : frames_of(k_requests[i % 3], i, auth)) {
+            wires[i].add(zmq::message_t(f.data(), f.size()));
+        }
+    }
+    return wires;
+}
+
+// As xzmq_serializer was: every part parsed once verified.
+xeus::xmessage parse_eagerly(zmq::multipart_t& wire, const xeus::xauthentication& auth) {
+    const auto text = [](const zmq::message_t& m) {
+        return std::string(m.data<const char>(), m.size());
+    };
+    xeus::xmessage::guid_list ids;
+    for (zmq::message_t frame = wire.pop(); text(frame) != "<IDS|MSG>"; frame = wire.pop()) {
+        ids.push_back(text(frame));
+    }
+    zmq::message_t signature = wire.pop();
+    zmq::message_t parts[4] = {wire.pop(), wire.pop(), wire.pop(), wire.pop()};
+    const auto buffer = [](const zmq::message_t& m) {
+        return xeus::xraw_buffer(m.data<const unsigned char>(), m.size());
+    };
+    if (!auth.verify(buffer(signature), buffer(parts[0]), buffer(parts[1]), buffer(parts[2]),
+                     buffer(parts[3]))) {
+        throw xeus::xsignature_error("ERROR: Signatures don't match");
+    }
+    const auto parse = [](const zmq::message_t& m) {
+        return nl::json::parse(m.data<const char>(), m.data<const char>() + m.size());
+    };
+    return xeus::xmessage(ids, parse(parts[0]), parse(parts[1]), parse(parts[2]),
+                          parse(parts[3]), {});
+}
+
+template <typename Receive>
+void run(const char* label, const xeus::xauthentication& auth, Receive receive) {
+    double best = 1e300;
+    for (int r = 0; r < mx::bench::k_runs; ++r) {
+        auto wires = make_wires(auth);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < k_messages; ++i) {
+            receive(wires[i], k_requests[i % 3].reads_content);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    mx::bench::report(label, k_messages, best, "msgs");
+}
+
+} // namespace
+
+int main() {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "bench-key");
+
+    mx::bench::title("kernel_info / is_complete / comm_msg, received and dispatched");
+    run("parsed up front, header copied", *auth, [&](zmq::multipart_t& wire, bool reads_content) {
+        xeus::xmessage msg = parse_eagerly(wire, *auth);
+        const nl::json header = msg.header();
+        mx::bench::keep(header.value("msg_type", ""));
+        if (reads_content) {
+            mx::bench::keep(msg.content().size());
+        }
+    });
+    run("parsed on access, header shared", *auth, [&](zmq::multipart_t& wire, bool reads_content) {
+        xeus::xmessage msg = xeus::xzmq_serializer::deserialize(wire, *auth);
+        const std::shared_ptr<const nl::json> header = msg.header_part().shared_value();
+        mx::bench::keep(header->value("msg_type", ""));
+        if (reads_content) {
+            mx::bench::keep(msg.content().size());
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,111 @@
+// One tick of a patch that sends its state with `dict` on every update, a
+// handful of values having changed since the last: the whole document as
+// pretty JSON, as without @diff, against the JSON Patch @diff publishes --
+// from the snapshot comparison, and from nl::json::diff, which is what a
+// change of shape falls back to.
+//
+// Each side starts from the snapshots, as the server thread does.
+
+#include "bench.h"
+
+#include "fake_dict.h"
+
+#include "../dict_diff.h"
+#include "../dict_snapshot.h"
+#include "../json_writer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+using namespace mx::bench;
+
+// Replays a snapshot into nl::json, as dict_diff.cpp's fallback does.
+struct builder {
+    nl::json root;
+    std::vector<nl::json*> open;
+    std::string pending;
+
+    nl::json& place(nl::json v) {
+        if (open.empty()) {
+            root = std::move(v);
+            return root;
+        }
+        nl::json& parent = *open.back();
+        if (parent.is_object()) {
+            return parent[pending] = std::move(v);
+        }
+        parent.push_back(std::move(v));
+        return parent.back();
+    }
+    void begin_object() { open.push_back(&place(nl::json::object())); }
+    void end_object() { open.pop_back(); }
+    void begin_array() { open.push_back(&place(nl::json::array())); }
+    void end_array() { open.pop_back(); }
+    void key(std::string_view k) { pending.assign(k.data(), k.size()); }
+    void value(std::string_view s) { place(std::string(s)); }
+    void value(long long v) { place(v); }
+    void value(double v) { place(v); }
+    void value(bool v) { place(v); }
+    void null() { place(nullptr); }
+};
+
+template <typename Publish>
+void run(const char* label, size_t entries, Publish publish) {
+    size_t bytes = 0;
+    const double seconds = mx::bench::best_of([&] { bytes = publish(); });
+    mx::bench::report(label, static_cast<double>(entries), seconds, "values",
+                      std::to_string(seconds * 1000.0).substr(0, 6) + " ms, "
+                          + std::to_string(bytes) + " bytes");
+}
+
+} // namespace
+
+int main() {
+    size_t entries = 0;
+    auto tree = make_tree(entries);
+    mx::dict_snapshot before;
+    walk(*tree, before);
+
+    // A tick's worth of change: ten voices' gain.
+    constexpr int k_changed = 10;
+    for (int i = 0; i < k_changed; ++i) {
+        fake_dict& bank = *tree->entries[i * 3 % k_banks].sub;
+        fake_dict& voice = *bank.entries[i * 37 % k_voices].sub;
+        voice.entries[2].value.d += 0.125;
+    }
+    mx::dict_snapshot after;
+    walk(*tree, after);
+
+    mx::bench::title("dict update, " + std::to_string(entries) + " values, "
+                     + std::to_string(k_changed) + " changed");
+    run("whole document, pretty JSON", entries, [&] {
+        std::string text;
+        mx::json_writer out(text, 2);
+        after.replay(out);
+        mx::bench::keep(text);
+        return text.size();
+    });
+    run("JSON Patch, snapshot comparison", entries, [&] {
+        std::string text;
+        mx::write_patch(before, after, text);
+        mx::bench::keep(text);
+        return text.size();
+    });
+    run("JSON Patch, nl::json::diff", entries, [&] {
+        builder from;
+        before.replay(from);
+        builder to;
+        after.replay(to);
+        std::string text = nl::json::diff(from.root, to.root).dump();
+        mx::bench::keep(text);
+        return text.size();
+    });
+    return 0;
+}
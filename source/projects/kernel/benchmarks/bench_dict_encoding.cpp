@@ -0,0 +1,98 @@
+// A large dictionary's round trip under each @encoding: encoded in the
+// kernel from its snapshot, then decoded as a client would, with nl::json
+// standing in for the client's decoder.
+//
+// Sizes are reported alongside: the binary encodings win as much on the
+// wire and in the client's parser as they do in the kernel.
+
+#include "bench.h"
+
+#include "fake_dict.h"
+
+#include "../dict_encoding.h"
+#include "../dict_snapshot.h"
+#include "../json_writer.h"
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+using namespace mx::bench;
+
+template <typename RoundTrip>
+void run(const char* label, size_t entries, RoundTrip round_trip) {
+    size_t bytes = 0;
+    const double seconds = mx::bench::best_of([&] { bytes = round_trip(); });
+    mx::bench::report(label, static_cast<double>(entries), seconds, "values",
+                      std::to_string(seconds * 1000.0).substr(0, 6) + " ms, "
+                          + std::to_string(bytes / 1024) + " KiB");
+}
+
+} // namespace
+
+int main() {
+    size_t entries = 0;
+    const auto tree = make_tree(entries);
+    mx::dict_snapshot snapshot;
+    walk(*tree, snapshot);
+
+    mx::bench::title("dict round trip, " + std::to_string(entries) + " values: encode in "
+                     "the kernel, decode in the client");
+    run("JSON, pretty (json)", entries, [&] {
+        std::string text;
+        mx::json_writer out(text, 2);
+        snapshot.replay(out);
+        nl::json j = nl::json::parse(text);
+        mx::bench::keep(j);
+        return text.size();
+    });
+    run("JSON, compact", entries, [&] {
+        std::string text;
+        mx::json_writer out(text);
+        snapshot.replay(out);
+        nl::json j = nl::json::parse(text);
+        mx::bench::keep(j);
+        return text.size();
+    });
+    run("CBOR (cbor)", entries, [&] {
+        std::vector<char> bytes;
+        mx::encode_cbor(snapshot, bytes);
+        nl::json j = nl::json::from_cbor(bytes);
+        mx::bench::keep(j);
+        return bytes.size();
+    });
+    run("MessagePack (msgpack)", entries, [&] {
+        std::vector<char> bytes;
+        mx::encode_msgpack(snapshot, bytes);
+        nl::json j = nl::json::from_msgpack(bytes);
+        mx::bench::keep(j);
+        return bytes.size();
+    });
+
+    mx::bench::title("encode only, in the kernel");
+    run("JSON, pretty", entries, [&] {
+        std::string text;
+        mx::json_writer out(text, 2);
+        snapshot.replay(out);
+        mx::bench::keep(text);
+        return text.size();
+    });
+    run("CBOR", entries, [&] {
+        std::vector<char> bytes;
+        mx::encode_cbor(snapshot, bytes);
+        mx::bench::keep(bytes);
+        return bytes.size();
+    });
+    run("MessagePack", entries, [&] {
+        std::vector<char> bytes;
+        mx::encode_msgpack(snapshot, bytes);
+        mx::bench::keep(bytes);
+        return bytes.size();
+    });
+    return 0;
+}
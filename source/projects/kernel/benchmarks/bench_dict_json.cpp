@@ -0,0 +1,82 @@
+// Serializing a large dictionary for `dict`: an nl::json tree dumped with
+// dump(2), as kernel_dict used to, against json_writer fed by the walk.
+//
+// Both sides walk the synthetic tree in fake_dict.h and produce the same
+// pretty-printed text, bar key order and float spelling.
+
+#include "bench.h"
+
+#include "fake_dict.h"
+
+#include "../json_writer.h"
+
+#include <string>
+#include <utility>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+using namespace mx::bench;
+
+// As dictionary_to_json / atom_to_json were.
+nl::json atom_to_json(const fake_atom& a) {
+    switch (a.type) {
+    case fake_atom::integer: return nl::json(a.l);
+    case fake_atom::real:    return nl::json(a.d);
+    case fake_atom::symbol:  return nl::json(a.s);
+    }
+    return nl::json(nullptr);
+}
+
+nl::json dict_to_json(const fake_dict& d) {
+    nl::json obj = nl::json::object();
+    for (const fake_entry& e : d.entries) {
+        const char* name = e.key.c_str();
+        if (e.kind == fake_entry::dict) {
+            obj[name] = dict_to_json(*e.sub);
+        } else if (e.kind == fake_entry::array) {
+            nl::json items = nl::json::array();
+            for (const fake_atom& a : e.items) {
+                items.push_back(atom_to_json(a));
+            }
+            obj[name] = std::move(items);
+        } else {
+            obj[name] = atom_to_json(e.value);
+        }
+    }
+    return obj;
+}
+
+template <typename Serialize>
+void run(const char* label, size_t entries, Serialize serialize) {
+    size_t bytes = 0;
+    const double seconds = mx::bench::best_of([&] {
+        std::string text = serialize();
+        bytes = text.size();
+        mx::bench::keep(text);
+    });
+    mx::bench::report(label, static_cast<double>(entries), seconds, "values",
+                      std::to_string(seconds * 1000.0).substr(0, 6) + " ms, "
+                          + std::to_string(bytes / 1024) + " KiB");
+}
+
+} // namespace
+
+int main() {
+    size_t entries = 0;
+    const auto tree = make_tree(entries);
+
+    mx::bench::title("dict -> pretty JSON, " + std::to_string(entries) + " values in "
+                     + std::to_string(k_banks * k_voices) + " nested objects");
+    run("nl::json tree + dump(2)", entries, [&] { return dict_to_json(*tree).dump(2); });
+    run("json_writer, one pass", entries, [&] {
+        std::string text;
+        mx::json_writer out(text, 2);
+        walk(*tree, out);
+        return text;
+    });
+    return 0;
+}
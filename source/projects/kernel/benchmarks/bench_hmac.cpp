@@ -0,0 +1,160 @@
+// Signing a small message with HMAC-SHA256 from 1 to 4 threads at once, the
+// way the server and publisher threads sign concurrently. One MAC context
+// behind a mutex, re-keyed for every message, as xauthentication was before
+// patch 0008, against the patched pool of keyed contexts.
+//
+// The thread counts only show scaling on a machine with that many free cores;
+// on fewer the lines above 1 thread measure contention and little else. Needs
+// OpenSSL, and xeus-zmq for its authentication header.
+
+#include "bench.h"
+
+#include "xauthentication.hpp"
+
+#include "xeus/xstring_utils.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/opensslv.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/params.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int k_signs_per_thread = 100000;
+constexpr int k_max_threads = 4;
+
+// A status message, about the size of the frames signed most often.
+const std::string k_header =
+    R"({"msg_id":"3c4b0c5e-9a5c-4a43-9b07-0fd2d7d31c1e","msg_type":"status",)"
+    R"("session":"b2d8c0f4-4e1c-47b6-8a53-9c1d1b8e7f22","username":"kernel",)"
+    R"("date":"2026-10-17T12:00:00.000000Z","version":"5.3"})";
+const std::string k_parent =
+    R"({"msg_id":"e1a5f7c2-3d4b-4c6e-8f90-1a2b3c4d5e6f","msg_type":"execute_request",)"
+    R"("session":"9f8e7d6c-5b4a-4392-8170-6f5e4d3c2b1a","username":"user",)"
+    R"("date":"2026-10-17T12:00:00.000000Z","version":"5.3"})";
+const std::string k_metadata = "{}";
+const std::string k_content = R"({"execution_state":"busy"})";
+
+xeus::xraw_buffer raw(const std::string& s) {
+    return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+// As xauthentication was: one context, locked and re-keyed for every message,
+// with the signature hex-encoded the same way.
+class locked_hmac {
+public:
+    explicit locked_hmac(const std::string& key) : m_key(key) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        m_mac = EVP_MAC_fetch(nullptr, "hmac", nullptr);
+        m_ctx = EVP_MAC_CTX_new(m_mac);
+        m_params[0] = OSSL_PARAM_construct_utf8_string("digest", m_digest, 0);
+        m_params[1] = OSSL_PARAM_construct_end();
+#else
+        m_ctx = HMAC_CTX_new();
+#endif
+    }
+
+    ~locked_hmac() {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC_CTX_free(m_ctx);
+        EVP_MAC_free(m_mac);
+#else
+        HMAC_CTX_free(m_ctx);
+#endif
+    }
+
+    std::string sign() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<unsigned char> sig(EVP_MAX_MD_SIZE);
+        size_t size = 0;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC_init(m_ctx, reinterpret_cast<const unsigned char*>(m_key.data()), m_key.size(),
+                     m_params);
+        for (const std::string* part : {&k_header, &k_parent, &k_metadata, &k_content}) {
+            EVP_MAC_update(m_ctx, reinterpret_cast<const unsigned char*>(part->data()),
+                           part->size());
+        }
+        EVP_MAC_final(m_ctx, sig.data(), &size, sig.size());
+#else
+        HMAC_Init_ex(m_ctx, m_key.data(), static_cast<int>(m_key.size()), EVP_sha256(), nullptr);
+        for (const std::string* part : {&k_header, &k_parent, &k_metadata, &k_content}) {
+            HMAC_Update(m_ctx, reinterpret_cast<const unsigned char*>(part->data()), part->size());
+        }
+        unsigned int length = 0;
+        HMAC_Final(m_ctx, sig.data(), &length);
+        size = length;
+#endif
+        sig.resize(size);
+        return xeus::hex_string(sig);
+    }
+
+private:
+    std::string m_key;
+    char m_digest[7] = "SHA256";
+    mutable std::mutex m_mutex;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC* m_mac = nullptr;
+    mutable OSSL_PARAM m_params[2];
+    EVP_MAC_CTX* m_ctx = nullptr;
+#else
+    HMAC_CTX* m_ctx = nullptr;
+#endif
+};
+
+// Signs k_signs_per_thread messages on each of `threads` threads, all started
+// together; returns the seconds until the last one finishes.
+template <typename Sign>
+double run_threads(int threads, Sign sign) {
+    return mx::bench::best_of([&] {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&] {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < k_signs_per_thread; ++i) {
+                    mx::bench::keep(sign());
+                }
+            });
+        }
+        go.store(true);
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    });
+}
+
+} // namespace
+
+int main() {
+    const std::string key = "6c3a2f6e-2b1d-4a0e-9c55-7d3c1e0f8a42";
+    const locked_hmac before(key);
+    const auto after = xeus::make_xauthentication("hmac-sha256", key);
+
+    std::printf("\n%u hardware threads\n", std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= k_max_threads; ++threads) {
+        mx::bench::title("HMAC-SHA256 of a status message, " + std::to_string(threads)
+                         + (threads == 1 ? " thread" : " threads"));
+        const double signs = double(threads) * k_signs_per_thread;
+        mx::bench::report("one context, locked (before 0008)", signs,
+                          run_threads(threads, [&] { return before.sign(); }), "signs");
+        mx::bench::report("pooled keyed contexts", signs,
+                          run_threads(threads, [&] {
+                              return after->sign(raw(k_header), raw(k_parent),
+                                                 raw(k_metadata), raw(k_content));
+                          }),
+                          "signs");
+    }
+    return 0;
+}
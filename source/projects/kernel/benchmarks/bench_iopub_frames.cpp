@@ -0,0 +1,106 @@
+// Serializing a large IOPub message: a display_data with 1 MiB of text and a
+// 4 MiB binary buffer, signed with HMAC-SHA256. Frames copied into ZMQ, as
+// xzmq_serializer did before patch 0006, against the patched serializer,
+// which hands the dumped JSON and the buffer to ZMQ without a copy.
+//
+// Needs libzmq and OpenSSL, like the tests, because it drives xeus-zmq's own
+// serializer. Message construction is outside the timed region.
+
+#include "bench.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_messages = 50;
+constexpr size_t k_text_bytes = 1 << 20;
+constexpr size_t k_buffer_bytes = 4 << 20;
+
+std::vector<xeus::xpub_message> make_messages() {
+    const std::string text(k_text_bytes, 'x');
+    std::vector<xeus::xpub_message> messages;
+    for (int i = 0; i < k_messages; ++i) {
+        nl::json content;
+        content["data"]["text/plain"] = text;
+        content["metadata"] = nl::json::object();
+        content["transient"] = nl::json::object();
+        xeus::buffer_sequence buffers;
+        buffers.emplace_back(k_buffer_bytes, '\x01');
+        messages.emplace_back("display_data", xeus::make_header("display_data", "", ""),
+                              nl::json::object(), nl::json::object(), std::move(content),
+                              std::move(buffers));
+    }
+    return messages;
+}
+
+// As xzmq_serializer was: each part dumped to a string and copied into its
+// frame, each buffer copied into its frame.
+zmq::multipart_t copy_frames(xeus::xpub_message&& msg, const xeus::xauthentication& auth) {
+    const auto frame = [](const nl::json& j) {
+        const std::string text = j.dump();
+        return zmq::message_t(text.data(), text.size());
+    };
+    const auto raw = [](const zmq::message_t& m) {
+        return xeus::xraw_buffer(m.data<const unsigned char>(), m.size());
+    };
+    zmq::message_t header = frame(msg.header());
+    zmq::message_t parent = frame(msg.parent_header());
+    zmq::message_t metadata = frame(msg.metadata());
+    zmq::message_t content = frame(msg.content());
+    const std::string sig = auth.sign(raw(header), raw(parent), raw(metadata), raw(content));
+
+    zmq::multipart_t wire;
+    wire.add(zmq::message_t(msg.topic().begin(), msg.topic().end()));
+    wire.add(zmq::message_t(sig.begin(), sig.end()));
+    wire.add(std::move(header));
+    wire.add(std::move(parent));
+    wire.add(std::move(metadata));
+    wire.add(std::move(content));
+    for (const xeus::binary_buffer& b : std::move(msg).buffers()) {
+        wire.add(zmq::message_t(b.data(), b.size()));
+    }
+    return wire;
+}
+
+template <typename Serialize>
+void run(const char* label, Serialize serialize) {
+    double best = 1e300;
+    for (int r = 0; r < mx::bench::k_runs; ++r) {
+        auto messages = make_messages();
+        const auto start = std::chrono::steady_clock::now();
+        for (auto& m : messages) {
+            zmq::multipart_t wire = serialize(std::move(m));
+            mx::bench::keep(wire);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    const double mib = k_messages * double(k_text_bytes + k_buffer_bytes) / (1 << 20);
+    mx::bench::report(label, k_messages, best, "msgs",
+                      std::to_string(static_cast<long>(mib / best)) + " MiB/s");
+}
+
+} // namespace
+
+int main() {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "bench-key");
+
+    mx::bench::title("display_data, 1 MiB text + 4 MiB buffer, signed");
+    run("frames copied (before 0006)", [&](xeus::xpub_message&& m) {
+        return copy_frames(std::move(m), *auth);
+    });
+    run("xzmq_serializer, frames adopted", [&](xeus::xpub_message&& m) {
+        return xeus::xzmq_serializer::serialize_iopub(std::move(m), *auth,
+                                                      nl::json::error_handler_t::strict);
+    });
+    return 0;
+}
@@ -0,0 +1,85 @@
+// A long streaming cell: 10k stream messages published under one request
+// context, each serialized and signed. As before patch 0012 -- the context's
+// header copied with the context for each publish, copied again as the parent
+// and dumped by the serializer -- against the context's shared header text,
+// written once for the whole cell.
+//
+// One line per message, as with @batch 0; coalescing makes fewer, longer
+// messages, but each still carries the parent header. Needs libzmq and
+// OpenSSL, like the tests, because it drives xeus-zmq's own serializer.
+
+#include "bench.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+#include "xeus/xrequest_context.hpp"
+
+#include <string>
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_lines = 10000;
+
+const std::string k_user = "kernel";
+const std::string k_session = "b2d8c0f4-4e1c-47b6-8a53-9c1d1b8e7f22";
+const std::string k_topic = "kernel_core.6c3a2f6e.stream";
+
+// An execute_request header as JupyterLab sends one.
+nl::json request_header() {
+    return nl::json{{"date", "2026-10-17T12:00:00.000000Z"},
+                    {"msg_id", "6f1c2b9e-0d3a-4e7b-8c5f-2a1b3c4d5e6f"},
+                    {"msg_type", "execute_request"},
+                    {"session", "9f8e7d6c-5b4a-4392-8170-6f5e4d3c2b1a"},
+                    {"username", "user"},
+                    {"version", "5.3"}};
+}
+
+nl::json stream_content(int line) {
+    return nl::json{{"name", "stdout"}, {"text", "line " + std::to_string(line) + "\n"}};
+}
+
+} // namespace
+
+int main() {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "bench-key");
+    const auto error_handler = nl::json::error_handler_t::strict;
+
+    mx::bench::title("stream output of a 10k-line cell, serialized and signed");
+
+    const nl::json header = request_header();
+    const double before = mx::bench::best_of([&] {
+        for (int i = 0; i < k_lines; ++i) {
+            const nl::json context_copy = header;
+            xeus::xmessage_raw_data data;
+            data.m_header = xeus::make_header_part("stream", k_user, k_session);
+            data.m_parent_header = nl::json(context_copy);
+            data.m_metadata = nl::json::object();
+            data.m_content = stream_content(i);
+            zmq::multipart_t wire = xeus::xzmq_serializer::serialize_iopub(
+                xeus::xpub_message(k_topic, std::move(data)), *auth, error_handler);
+            mx::bench::keep(wire);
+        }
+    });
+    mx::bench::report("parent header dumped (before 0012)", k_lines, before, "messages");
+
+    const double after = mx::bench::best_of([&] {
+        // A new context per cell, so the header is written once per run.
+        const xeus::xrequest_context context(request_header(), {});
+        for (int i = 0; i < k_lines; ++i) {
+            const xeus::xrequest_context context_copy = context;
+            xeus::xmessage_raw_data data;
+            data.m_header = xeus::make_header_part("stream", k_user, k_session);
+            data.m_parent_header = context_copy.header_part();
+            data.m_metadata = nl::json::object();
+            data.m_content = stream_content(i);
+            zmq::multipart_t wire = xeus::xzmq_serializer::serialize_iopub(
+                xeus::xpub_message(k_topic, std::move(data)), *auth, error_handler);
+            mx::bench::keep(wire);
+        }
+    });
+    mx::bench::report("shared parent header text", k_lines, after, "messages");
+    return 0;
+}
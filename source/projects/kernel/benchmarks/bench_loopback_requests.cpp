@@ -0,0 +1,111 @@
+// Requests per second from a programmatic client over loopback: a real
+// xkernel with the Max interpreter, and a DEALER socket sending signed
+// is_complete_requests, up to k_in_flight at a time, until every reply is
+// back. Each request also costs the kernel a busy and an idle status on IOPub,
+// serialized and signed even with nobody subscribed -- the part patch 0011
+// made cheaper; bench_status_messages isolates it.
+//
+// Needs libzmq and OpenSSL, and binds loopback ports like the integration
+// tests. No Max SDK.
+
+#include "bench.h"
+
+#include "../connection.h"
+#include "../interpreter.h"
+#include "../types.h"
+
+#include "xauthentication.hpp"
+
+#include "xeus/xhistory_manager.hpp"
+#include "xeus/xkernel.hpp"
+#include "xeus/xkernel_configuration.hpp"
+#include "xeus/xsystem.hpp"
+#include "xeus-zmq/xserver_zmq.hpp"
+#include "xeus-zmq/xzmq_context.hpp"
+#include "zmq.hpp"
+#include "zmq_addon.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr int k_requests = 20000;
+constexpr int k_in_flight = 32;
+
+xeus::xraw_buffer raw(const std::string& s) {
+    return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+void send_request(zmq::socket_t& dealer, const xeus::xauthentication& auth, int n) {
+    const std::string header =
+        R"({"date":"2026-10-17T12:00:00.000000Z","msg_id":"bench-)" + std::to_string(n)
+        + R"(","msg_type":"is_complete_request","session":"bench","username":"bench",)"
+          R"("version":"5.3"})";
+    const std::string content = R"({"code":"metro 100"})";
+    zmq::multipart_t request;
+    request.addstr("<IDS|MSG>");
+    request.addstr(auth.sign(raw(header), raw("{}"), raw("{}"), raw(content)));
+    request.addstr(header);
+    request.addstr("{}");
+    request.addstr("{}");
+    request.addstr(content);
+    request.send(dealer);
+}
+
+} // namespace
+
+int main() {
+    mx::t_kernel_impl impl;
+    xeus::xconfiguration config = mx::create_kernel_configuration();
+    std::unique_ptr<xeus::xinterpreter> interp(new mx::max_interpreter(&impl));
+    xeus::xkernel kernel(config, xeus::get_user_name(),
+                         std::unique_ptr<xeus::xcontext>(xeus::make_zmq_context()),
+                         std::move(interp), xeus::make_xserver_default,
+                         xeus::make_in_memory_history_manager());
+    auto* server = dynamic_cast<xeus::xserver_zmq*>(&kernel.get_server());
+    if (server == nullptr) {
+        std::fprintf(stderr, "not a ZMQ server\n");
+        return 1;
+    }
+    server->set_poll_timeout(20);
+    std::atomic<bool> serving{false};
+    server->set_idle_callback([&serving] { serving.store(true); });
+    std::thread thread([&kernel] { kernel.start(); });
+    while (!serving.load()) {
+        std::this_thread::sleep_for(5ms);
+    }
+
+    const xeus::xconfiguration& bound = kernel.get_config();
+    const auto auth = xeus::make_xauthentication(bound.m_signature_scheme, bound.m_key);
+    zmq::context_t context;
+    zmq::socket_t dealer(context, zmq::socket_type::dealer);
+    dealer.set(zmq::sockopt::linger, 0);
+    dealer.connect("tcp://127.0.0.1:" + bound.m_shell_port);
+
+    mx::bench::title("is_complete_request round trips over loopback");
+    const double seconds = mx::bench::best_of([&] {
+        int sent = 0;
+        int received = 0;
+        while (received < k_requests) {
+            while (sent < k_requests && sent - received < k_in_flight) {
+                send_request(dealer, *auth, sent++);
+            }
+            zmq::multipart_t reply;
+            reply.recv(dealer);
+            ++received;
+        }
+    });
+    mx::bench::report("requests, " + std::to_string(k_in_flight) + " in flight", k_requests,
+                      seconds, "requests");
+
+    kernel.stop();
+    thread.join();
+    return 0;
+}
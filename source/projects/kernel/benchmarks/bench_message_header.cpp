@@ -0,0 +1,76 @@
+// Making the header of an outgoing message, as the kernel does for every
+// status, stream line and reply, through to the JSON text the serializer
+// sends. make_header as it was before patch 0010 -- a libuuid id, a date from
+// an ostringstream and gmtime, six insertions into an nl::json object, then a
+// dump -- against today's make_header and dump, and make_header_part, which
+// writes the text directly.
+
+#include "bench.h"
+
+#include "xeus/xguid.hpp"
+#include "xeus/xmessage.hpp"
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_headers = 200000;
+
+const std::string k_user = "kernel";
+const std::string k_session = "b2d8c0f4-4e1c-47b6-8a53-9c1d1b8e7f22";
+
+// As xeus was.
+std::string old_iso8601_now() {
+    std::ostringstream ss;
+    auto now = std::chrono::system_clock::now();
+    auto itt = std::chrono::system_clock::to_time_t(now);
+    ss << std::put_time(std::gmtime(&itt), "%FT%T");
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+    ss << "." << micros.count() % 1000000 << "Z";
+    return ss.str();
+}
+
+nl::json old_make_header(const std::string& msg_type) {
+    nl::json header;
+    header["msg_id"] = xeus::new_xguid();
+    header["username"] = k_user;
+    header["session"] = k_session;
+    header["date"] = old_iso8601_now();
+    header["msg_type"] = msg_type;
+    header["version"] = xeus::get_protocol_version();
+    return header;
+}
+
+template <typename Make>
+void run(const char* label, Make make, const char* unit = "headers") {
+    const double seconds = mx::bench::best_of([&] {
+        for (int i = 0; i < k_headers; ++i) {
+            mx::bench::keep(make());
+        }
+    });
+    mx::bench::report(label, k_headers, seconds, unit);
+}
+
+} // namespace
+
+int main() {
+    const std::string msg_type = "stream";
+
+    mx::bench::title("status / stream header, made and written as JSON");
+    run("make_header + dump (before 0010)", [&] { return old_make_header(msg_type).dump(); });
+    run("make_header + dump", [&] { return xeus::make_header(msg_type, k_user, k_session).dump(); });
+    run("make_header_part", [&] {
+        return xeus::make_header_part(msg_type, k_user, k_session).raw()->size();
+    });
+
+    mx::bench::title("date alone");
+    run("ostringstream + gmtime (before 0010)", [] { return old_iso8601_now(); }, "dates");
+    run("iso8601_now", [] { return xeus::iso8601_now(); }, "dates");
+    return 0;
+}
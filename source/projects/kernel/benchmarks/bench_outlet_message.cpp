@@ -0,0 +1,168 @@
+// Outlet message cost: the old struct against the flat encoding.
+//
+// Each iteration does what happens to one cell between the interpreter and
+// outlet_anything: build the message on the kernel thread, pass it through
+// the ring, walk its atoms into a t_atom-like array on the main thread, and
+// -- for the flat encoding -- hand it back through the free list. Both sides
+// run on one thread, so the figures are the messages' own cost, free of
+// scheduling.
+//
+// Allocations are counted by replacing the global operator new for this
+// executable.
+
+#include "bench.h"
+
+#include "../message_queue.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+
+std::atomic<long> g_allocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr long k_messages = 1000000;
+
+// Longer than any small-string buffer, as most cells are.
+const std::string k_code = "metro 100 @active 1 @interval 250 @quantize 4n";
+
+// OutletMessage as it was: a selector string and a vector of variants.
+using legacy_atom = std::variant<std::string, long, double>;
+
+struct legacy_message {
+    std::string selector;
+    std::vector<legacy_atom> atoms;
+    int outlet_index = 0;
+    int execution_counter = 0;
+    int body_index = -1;
+};
+
+// Stands in for t_atom: a tag and a payload, the string as a pointer.
+struct fake_atom {
+    int type;
+    union {
+        long l;
+        double d;
+        const char* s;
+    };
+};
+
+void run_legacy() {
+    mx::SpscRing<legacy_message> ring(64);
+    fake_atom atoms[8];
+
+    long allocations = 0;
+    const double seconds = mx::bench::best_of([&] {
+        const long before = g_allocations.load();
+        for (long i = 0; i < k_messages; ++i) {
+            legacy_message msg;
+            msg.selector = "code";
+            msg.atoms.push_back(std::string("execute"));
+            msg.atoms.push_back(k_code);
+            msg.execution_counter = static_cast<int>(i);
+            ring.push(std::move(msg));
+
+            auto out = ring.try_pop();
+            for (size_t a = 0; a < out->atoms.size(); ++a) {
+                const auto& v = out->atoms[a];
+                if (std::holds_alternative<std::string>(v)) {
+                    atoms[a].type = 3;
+                    atoms[a].s = std::get<std::string>(v).c_str();
+                } else if (std::holds_alternative<long>(v)) {
+                    atoms[a].type = 1;
+                    atoms[a].l = std::get<long>(v);
+                } else {
+                    atoms[a].type = 2;
+                    atoms[a].d = std::get<double>(v);
+                }
+            }
+            mx::bench::keep(atoms);
+            mx::bench::keep(out->selector.c_str());
+        }
+        allocations = g_allocations.load() - before;
+    });
+
+    mx::bench::report("selector string + vector<variant>", k_messages, seconds, "msgs",
+                      std::to_string(static_cast<double>(allocations) / k_messages)
+                          .substr(0, 4) + " allocations/msg");
+}
+
+void run_flat() {
+    mx::SpscRing<mx::OutletMessage> ring(64);
+    mx::SpscRing<mx::OutletMessage> free_list(64);
+    fake_atom atoms[8];
+
+    long allocations = 0;
+    const double seconds = mx::bench::best_of([&] {
+        const long before = g_allocations.load();
+        for (long i = 0; i < k_messages; ++i) {
+            mx::OutletMessage msg;
+            if (auto spent = free_list.try_pop()) {
+                msg = std::move(*spent);
+            }
+            msg.selector = mx::outlet_selector::code;
+            msg.add_symbol("execute");
+            msg.body_index = static_cast<int>(msg.size());
+            msg.add_symbol(k_code);
+            msg.execution_counter = static_cast<int>(i);
+            ring.push(std::move(msg));
+
+            auto out = ring.try_pop();
+            for (size_t a = 0; a < out->size(); ++a) {
+                switch (out->tag(a)) {
+                case mx::atom_tag::symbol:
+                    atoms[a].type = 3;
+                    atoms[a].s = out->symbol_cstr(a);
+                    break;
+                case mx::atom_tag::integer:
+                    atoms[a].type = 1;
+                    atoms[a].l = out->integer(a);
+                    break;
+                case mx::atom_tag::real:
+                    atoms[a].type = 2;
+                    atoms[a].d = out->real(a);
+                    break;
+                }
+            }
+            mx::bench::keep(atoms);
+            mx::bench::keep(mx::selector_name(out->selector));
+
+            out->clear();
+            free_list.push(std::move(*out));
+        }
+        allocations = g_allocations.load() - before;
+    });
+
+    mx::bench::report("flat buffer + free list", k_messages, seconds, "msgs",
+                      std::to_string(static_cast<double>(allocations) / k_messages)
+                          .substr(0, 4) + " allocations/msg");
+}
+
+} // namespace
+
+int main() {
+    mx::bench::title("outlet message build -> ring -> t_atoms, "
+                     + std::to_string(k_messages) + " cells");
+    run_legacy();
+    run_flat();
+    return 0;
+}
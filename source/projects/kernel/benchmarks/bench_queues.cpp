@@ -0,0 +1,125 @@
+// Queue hand-over between two threads: ThreadSafeQueue against SpscRing.
+//
+// One thread pushes, another pops, both flat out -- the worst case for the
+// locked queue, whose every push and pop contends for the same mutex, and the
+// case outlet_queue sees when a burst of cells is handed to Max. Measured
+// with a bare integer, which isolates the queue's own cost, and with a
+// typical OutletMessage, which is what the kernel actually moves.
+//
+// Each is measured twice on the consumer side: popping one item at a time,
+// and taking the whole backlog with drain_into, as the kernel's consumers do.
+//
+// When the ring is full the producer yields and retries, and so does the
+// consumer when either queue is empty, so the figures include that back-off.
+// "stalls" counts the producer's retries. On a single core the two threads
+// take turns rather than contend, and the figures mostly measure scheduling.
+
+#include "bench.h"
+
+#include "../message_queue.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr long k_items = 1000000;
+constexpr size_t k_ring_capacity = 1024;
+
+mx::OutletMessage make_message(long i) {
+    mx::OutletMessage msg;
+    msg.selector = mx::outlet_selector::code;
+    msg.add_symbol("execute");
+    msg.add_symbol("metro 100");
+    msg.execution_counter = static_cast<int>(i);
+    return msg;
+}
+
+// Pop k_items, one at a time or a backlog at a time. Returns how many times
+// the consumer went to the queue and came back with something -- for the
+// locked queue, a lower bound on its lock acquisitions.
+template <typename Queue, typename T>
+long consume(Queue& q, bool drain, std::vector<T>& batch) {
+    long visits = 0;
+    for (long got = 0; got < k_items;) {
+        if (drain) {
+            batch.clear();
+            if (q.drain_into(batch) > 0) {
+                got += static_cast<long>(batch.size());
+                mx::bench::keep(batch.back());
+                ++visits;
+                continue;
+            }
+        } else if (auto item = q.try_pop()) {
+            mx::bench::keep(*item);
+            ++got;
+            ++visits;
+            continue;
+        }
+        std::this_thread::yield();
+    }
+    return visits;
+}
+
+template <typename T, typename Make>
+void run_locked(const std::string& label, Make make, bool drain) {
+    long visits = 0;
+    const double seconds = mx::bench::best_of([&] {
+        mx::ThreadSafeQueue<T> q;
+        std::thread producer([&] {
+            for (long i = 0; i < k_items; ++i) {
+                q.push(make(i));
+            }
+        });
+        std::vector<T> batch;
+        visits = consume(q, drain, batch);
+        producer.join();
+    });
+    mx::bench::report(label, k_items, seconds, "items",
+                      std::to_string(visits) + " non-empty visits");
+}
+
+template <typename T, typename Make>
+void run_ring(const std::string& label, Make make, bool drain) {
+    long stalls = 0;
+    long visits = 0;
+    const double seconds = mx::bench::best_of([&] {
+        mx::SpscRing<T> q(k_ring_capacity);
+        stalls = 0;
+        std::thread producer([&] {
+            for (long i = 0; i < k_items; ++i) {
+                T item = make(i);
+                while (!q.push(std::move(item))) {
+                    ++stalls;
+                    std::this_thread::yield();
+                }
+            }
+        });
+        std::vector<T> batch;
+        visits = consume(q, drain, batch);
+        producer.join();
+    });
+    mx::bench::report(label, k_items, seconds, "items",
+                      std::to_string(visits) + " non-empty visits, "
+                      + std::to_string(stalls) + " stalls");
+}
+
+} // namespace
+
+int main() {
+    const auto make_long = [](long i) { return i; };
+
+    mx::bench::title("queue hand-over, 1 producer / 1 consumer, "
+                     + std::to_string(k_items) + " items");
+    for (bool drain : {false, true}) {
+        const std::string how = drain ? " drain" : " try_pop";
+        run_locked<long>("ThreadSafeQueue<long>" + how, make_long, drain);
+        run_ring<long>("SpscRing<long>" + how, make_long, drain);
+        run_locked<mx::OutletMessage>("ThreadSafeQueue<OutletMessage>" + how,
+                                      make_message, drain);
+        run_ring<mx::OutletMessage>("SpscRing<OutletMessage>" + how,
+                                    make_message, drain);
+    }
+    return 0;
+}
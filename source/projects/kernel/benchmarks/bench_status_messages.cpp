@@ -0,0 +1,107 @@
+// The busy and idle statuses published around every request, serialized and
+// signed. As xkernel_core built them before patch 0011 -- the request header
+// copied as the parent, and parent, metadata and content each dumped afresh --
+// against the status fast path, which sends the request header as the bytes it
+// arrived as and the metadata and content as texts written once, so only the
+// new header is written per status.
+//
+// Needs libzmq and OpenSSL, like the tests, because it drives xeus-zmq's own
+// serializer. bench_loopback_requests measures the whole round trip.
+
+#include "bench.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+
+#include <memory>
+#include <string>
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_requests = 50000;
+
+const std::string k_user = "kernel";
+const std::string k_session = "b2d8c0f4-4e1c-47b6-8a53-9c1d1b8e7f22";
+const std::string k_topic = "kernel_core.6c3a2f6e.status";
+
+xeus::xraw_buffer raw(const std::string& s) {
+    return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+// A request as received: header unparsed until dispatch reads it.
+xeus::xmessage receive_request(const xeus::xauthentication& auth) {
+    const std::string header =
+        R"({"date":"2026-10-17T12:00:00.000000Z","msg_id":"6f1c2b9e-0d3a-4e7b-8c5f-2a1b3c4d5e6f",)"
+        R"("msg_type":"is_complete_request","session":"9f8e7d6c-5b4a-4392-8170-6f5e4d3c2b1a",)"
+        R"("username":"user","version":"5.3"})";
+    const std::string content = R"({"code":"metro 100"})";
+    zmq::multipart_t wire;
+    wire.add(zmq::message_t("<IDS|MSG>", 9));
+    const std::string sig = auth.sign(raw(header), raw("{}"), raw("{}"), raw(content));
+    for (const std::string* frame : {&sig, &header}) {
+        wire.add(zmq::message_t(frame->data(), frame->size()));
+    }
+    wire.add(zmq::message_t("{}", 2));
+    wire.add(zmq::message_t("{}", 2));
+    wire.add(zmq::message_t(content.data(), content.size()));
+    xeus::xmessage msg = xeus::xzmq_serializer::deserialize(wire, auth);
+    msg.header();
+    return msg;
+}
+
+xeus::xmessage_part constant_part(const nl::json& value) {
+    xeus::xmessage_part part(std::make_shared<const std::string>(value.dump()));
+    part.value();
+    return part;
+}
+
+} // namespace
+
+int main() {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "bench-key");
+    const xeus::xmessage request = receive_request(*auth);
+    const auto error_handler = nl::json::error_handler_t::strict;
+
+    mx::bench::title("busy + idle status for one request, serialized and signed");
+
+    const double before = mx::bench::best_of([&] {
+        for (int i = 0; i < k_requests; ++i) {
+            for (const char* state : {"busy", "idle"}) {
+                nl::json content;
+                content["execution_state"] = state;
+                xeus::xmessage_raw_data data;
+                data.m_header = xeus::make_header_part("status", k_user, k_session);
+                data.m_parent_header = nl::json(request.header());
+                data.m_metadata = nl::json::object();
+                data.m_content = std::move(content);
+                zmq::multipart_t wire = xeus::xzmq_serializer::serialize_iopub(
+                    xeus::xpub_message(k_topic, std::move(data)), *auth, error_handler);
+                mx::bench::keep(wire);
+            }
+        }
+    });
+    mx::bench::report("parts dumped per status (before 0011)", k_requests, before, "requests");
+
+    const xeus::xmessage_part metadata = constant_part(nl::json::object());
+    const xeus::xmessage_part busy = constant_part({{"execution_state", "busy"}});
+    const xeus::xmessage_part idle = constant_part({{"execution_state", "idle"}});
+    const double after = mx::bench::best_of([&] {
+        for (int i = 0; i < k_requests; ++i) {
+            for (const xeus::xmessage_part* state : {&busy, &idle}) {
+                xeus::xmessage_raw_data data;
+                data.m_header = xeus::make_header_part("status", k_user, k_session);
+                data.m_parent_header = request.header_part();
+                data.m_metadata = metadata;
+                data.m_content = *state;
+                zmq::multipart_t wire = xeus::xzmq_serializer::serialize_iopub(
+                    xeus::xpub_message(k_topic, std::move(data)), *auth, error_handler);
+                mx::bench::keep(wire);
+            }
+        }
+    });
+    mx::bench::report("status fast path", k_requests, after, "requests");
+    return 0;
+}
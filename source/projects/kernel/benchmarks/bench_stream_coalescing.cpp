@@ -0,0 +1,84 @@
+// Stream output throughput, with and without batching.
+//
+// Models a patch printing from [metro 1]: bursts of `print` lines queued while
+// no cell is running, flushed by the server loop's idle tick. The publisher
+// does what xkernel_core::publish_message does per message -- a fresh header
+// with GUID and timestamp, and a JSON dump of all four parts -- but stops
+// short of HMAC signing and the socket, so the per-message saving measured
+// here understates the real one.
+
+#include "bench.h"
+
+#include "../interpreter.h"
+#include "../types.h"
+
+#include <string>
+
+#include "xeus/xmessage.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+constexpr int k_lines = 100000;
+constexpr int k_lines_per_tick = 100;
+
+struct counting_publisher {
+    long messages = 0;
+    long bytes = 0;
+
+    void operator()(xeus::xrequest_context ctx, const std::string& msg_type,
+                    nl::json metadata, nl::json content, xeus::buffer_sequence) {
+        const nl::json header = xeus::make_header(msg_type, "bench", "session");
+        bytes += header.dump().size();
+        bytes += ctx.header().dump().size();
+        bytes += metadata.dump().size();
+        bytes += content.dump().size();
+        ++messages;
+    }
+};
+
+void run(const char* label, long batch_bytes) {
+    mx::t_kernel_impl impl;
+    impl.stream_batch_bytes.store(batch_bytes);
+    // Measure coalescing alone: the rate limits would drop most of the flood.
+    impl.iopub_msg_rate_limit.store(0);
+    impl.iopub_data_rate_limit.store(0);
+    mx::max_interpreter interp(&impl);
+
+    counting_publisher totals;
+    interp.register_publisher(
+        [&totals](xeus::xrequest_context ctx, const std::string& msg_type,
+                  nl::json metadata, nl::json content, xeus::buffer_sequence buffers) {
+            totals(std::move(ctx), msg_type, std::move(metadata),
+                   std::move(content), std::move(buffers));
+        });
+
+    const double seconds = mx::bench::best_of([&] {
+        totals = counting_publisher{};
+        for (int i = 0; i < k_lines; i += k_lines_per_tick) {
+            for (int j = 0; j < k_lines_per_tick; ++j) {
+                mx::ResultMessage line;
+                line.stream_name = "stdout";
+                line.text = "metro tick " + std::to_string(i + j);
+                impl.async_queue.push(std::move(line));
+            }
+            interp.on_idle();
+        }
+    });
+
+    mx::bench::report(label, k_lines, seconds, "lines",
+                      std::to_string(totals.messages) + " IOPub messages, "
+                      + std::to_string(static_cast<long>(totals.messages / seconds))
+                      + " msgs/s, " + std::to_string(totals.bytes / 1024) + " KiB");
+}
+
+} // namespace
+
+int main() {
+    mx::bench::title("print -> IOPub stream, " + std::to_string(k_lines)
+                     + " lines in ticks of " + std::to_string(k_lines_per_tick));
+    run("one message per line (batching off)", 0);
+    run("batched per tick (default cap)", mx::t_kernel_impl{}.stream_batch_bytes.load());
+    return 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// A synthetic dictionary for the `dict` benchmarks, standing in for
+// t_dictionary: a few thousand voices, each an object of scalars and a
+// 16-element atom array, grouped under banks.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mx {
+namespace bench {
+
+constexpr int k_banks = 40;
+constexpr int k_voices = 500; // per bank
+
+// Stands in for t_atom and t_dictionary.
+struct fake_atom {
+    enum { integer, real, symbol } type;
+    long long l = 0;
+    double d = 0.0;
+    std::string s;
+};
+
+struct fake_dict;
+
+struct fake_entry {
+    std::string key;
+    enum { atom, array, dict } kind;
+    fake_atom value;
+    std::vector<fake_atom> items;
+    std::unique_ptr<fake_dict> sub;
+};
+
+struct fake_dict {
+    std::vector<fake_entry> entries;
+};
+
+inline fake_atom make_long(long long v) { fake_atom a; a.type = fake_atom::integer; a.l = v; return a; }
+inline fake_atom make_double(double v) { fake_atom a; a.type = fake_atom::real; a.d = v; return a; }
+inline fake_atom make_symbol(std::string v) { fake_atom a; a.type = fake_atom::symbol; a.s = std::move(v); return a; }
+
+inline fake_entry atom_entry(std::string key, fake_atom value) {
+    fake_entry e;
+    e.key = std::move(key);
+    e.kind = fake_entry::atom;
+    e.value = std::move(value);
+    return e;
+}
+
+// Returns the tree; `entries` counts its scalar values.
+inline std::unique_ptr<fake_dict> make_tree(size_t& entries) {
+    auto root = std::make_unique<fake_dict>();
+    for (int b = 0; b < k_banks; ++b) {
+        auto bank = std::make_unique<fake_dict>();
+        for (int v = 0; v < k_voices; ++v) {
+            auto voice = std::make_unique<fake_dict>();
+            voice->entries.push_back(atom_entry("name", make_symbol("voice_" + std::to_string(v))));
+            voice->entries.push_back(atom_entry("note", make_long(36 + v % 60)));
+            voice->entries.push_back(atom_entry("gain", make_double(0.5 + v * 0.001)));
+            voice->entries.push_back(atom_entry("wave", make_symbol(v % 2 ? "saw" : "sine")));
+            fake_entry env;
+            env.key = "envelope";
+            env.kind = fake_entry::array;
+            for (int i = 0; i < 16; ++i) {
+                env.items.push_back(make_double(i / 15.0));
+            }
+            voice->entries.push_back(std::move(env));
+            entries += 5 + 16;
+
+            fake_entry e;
+            e.key = "v" + std::to_string(v);
+            e.kind = fake_entry::dict;
+            e.sub = std::move(voice);
+            bank->entries.push_back(std::move(e));
+        }
+        fake_entry e;
+        e.key = "bank" + std::to_string(b);
+        e.kind = fake_entry::dict;
+        e.sub = std::move(bank);
+        root->entries.push_back(std::move(e));
+    }
+    return root;
+}
+
+// Walks the tree the way the external walks a t_dictionary -- keys, then
+// each entry by type -- making json_writer's calls on `out`.
+template <typename Out>
+void walk_atom(const fake_atom& a, Out& out) {
+    switch (a.type) {
+    case fake_atom::integer: out.value(a.l); return;
+    case fake_atom::real:    out.value(a.d); return;
+    case fake_atom::symbol:  out.value(a.s); return;
+    }
+}
+
+template <typename Out>
+void walk(const fake_dict& d, Out& out) {
+    out.begin_object();
+    for (const fake_entry& e : d.entries) {
+        out.key(e.key);
+        if (e.kind == fake_entry::dict) {
+            walk(*e.sub, out);
+        } else if (e.kind == fake_entry::array) {
+            out.begin_array();
+            for (const fake_atom& a : e.items) {
+                walk_atom(a, out);
+            }
+            out.end_array();
+        } else {
+            walk_atom(e.value, out);
+        }
+    }
+    out.end_object();
+}
+
+} // namespace bench
+} // namespace mx
@@ -0,0 +1,220 @@
+#include "dict_diff.h"
+#include "json_writer.h"
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace mx {
+
+namespace {
+
+using kind = dict_snapshot::kind;
+
+bool is_scalar(kind k) {
+    return k != kind::begin_object && k != kind::end_object
+        && k != kind::begin_array && k != kind::end_array && k != kind::key;
+}
+
+bool same_value(const dict_snapshot& a, const dict_snapshot& b, size_t i) {
+    const kind k = a.kind_at(i);
+    if (k != b.kind_at(i)) {
+        return false;
+    }
+    switch (k) {
+    case kind::string:  return a.text_at(i) == b.text_at(i);
+    case kind::integer: return a.integer_at(i) == b.integer_at(i);
+    case kind::real: {
+        const double x = a.real_at(i);
+        const double y = b.real_at(i);
+        // NaN is written as null either way; do not report it as a change.
+        return x == y || (x != x && y != y);
+    }
+    default:            return true;
+    }
+}
+
+void write_value(const dict_snapshot& s, size_t i, json_writer& out) {
+    switch (s.kind_at(i)) {
+    case kind::string:      out.value(s.text_at(i)); break;
+    case kind::integer:     out.value(s.integer_at(i)); break;
+    case kind::real:        out.value(s.real_at(i)); break;
+    case kind::true_value:  out.value(true); break;
+    case kind::false_value: out.value(false); break;
+    default:                out.null(); break;
+    }
+}
+
+// One level of the path to the record being compared.
+struct frame {
+    bool is_object;
+    size_t index;         // arrays: the current element
+    std::string_view key; // objects: the current key
+};
+
+// RFC 6901: "~" and "/" in a key are escaped as "~0" and "~1".
+void append_pointer(const std::vector<frame>& path, std::string& out) {
+    for (const frame& f : path) {
+        out += '/';
+        if (!f.is_object) {
+            out += std::to_string(f.index);
+            continue;
+        }
+        for (char c : f.key) {
+            if (c == '~') {
+                out += "~0";
+            } else if (c == '/') {
+                out += "~1";
+            } else {
+                out += c;
+            }
+        }
+    }
+}
+
+// The fast path: both snapshots have the same shape, so record i of one is
+// record i of the other and only scalars can differ. Returns false as soon as
+// the shapes turn out to differ, leaving `out` to be discarded.
+bool write_replacements(const dict_snapshot& from, const dict_snapshot& to,
+                        json_writer& out) {
+    if (from.size() != to.size()) {
+        return false;
+    }
+
+    std::vector<frame> path;
+    std::string pointer;
+    const auto next_element = [&path] {
+        if (!path.empty() && !path.back().is_object) {
+            ++path.back().index;
+        }
+    };
+
+    out.begin_array();
+    for (size_t i = 0; i < to.size(); ++i) {
+        const kind k = to.kind_at(i);
+        if (is_scalar(k) && is_scalar(from.kind_at(i))) {
+            if (!same_value(from, to, i)) {
+                pointer.clear();
+                append_pointer(path, pointer);
+                out.begin_object();
+                out.key("op");
+                out.value("replace");
+                out.key("path");
+                out.value(pointer);
+                out.key("value");
+                write_value(to, i, out);
+                out.end_object();
+            }
+            next_element();
+            continue;
+        }
+        if (k != from.kind_at(i)) {
+            return false;
+        }
+        switch (k) {
+        case kind::begin_object: path.push_back({true, 0, {}}); break;
+        case kind::begin_array:  path.push_back({false, 0, {}}); break;
+        case kind::end_object:
+        case kind::end_array:
+            path.pop_back();
+            next_element();
+            break;
+        case kind::key:
+            if (to.text_at(i) != from.text_at(i)) {
+                return false;
+            }
+            path.back().key = to.text_at(i);
+            break;
+        default:
+            break;
+        }
+    }
+    out.end_array();
+    return true;
+}
+
+// Replays a snapshot into an nl::json document, for the general diff.
+class json_builder {
+public:
+    explicit json_builder(nl::json& root) : m_root(root) {}
+
+    void begin_object() { open(nl::json::object()); }
+    void end_object() { m_open.pop_back(); }
+    void begin_array() { open(nl::json::array()); }
+    void end_array() { m_open.pop_back(); }
+
+    void key(std::string_view name) { m_key.assign(name.data(), name.size()); }
+
+    void value(std::string_view text) { place(std::string(text)); }
+    void value(long long number) { place(number); }
+    void value(double number) { place(number); }
+    void value(bool flag) { place(flag); }
+    void null() { place(nullptr); }
+
+private:
+    // Containers are only appended to once their children are closed, so the
+    // pointers in m_open stay valid.
+    nl::json& place(nl::json v) {
+        if (m_open.empty()) {
+            m_root = std::move(v);
+            return m_root;
+        }
+        nl::json& parent = *m_open.back();
+        if (parent.is_object()) {
+            return parent[m_key] = std::move(v);
+        }
+        parent.push_back(std::move(v));
+        return parent.back();
+    }
+
+    void open(nl::json container) { m_open.push_back(&place(std::move(container))); }
+
+    nl::json& m_root;
+    std::vector<nl::json*> m_open;
+    std::string m_key;
+};
+
+nl::json to_json(const dict_snapshot& s) {
+    nl::json doc;
+    json_builder builder(doc);
+    s.replay(builder);
+    return doc;
+}
+
+} // namespace
+
+void write_patch(const dict_snapshot& from, const dict_snapshot& to, std::string& out) {
+    const size_t start = out.size();
+    json_writer writer(out);
+    if (write_replacements(from, to, writer)) {
+        return;
+    }
+    out.resize(start);
+    // Replace invalid UTF-8 as json_writer does on the same-shape path; the
+    // strict default would throw on the server thread over one bad symbol.
+    out += nl::json::diff(to_json(from), to_json(to))
+               .dump(-1, ' ', false, nl::json::error_handler_t::replace);
+}
+
+dict_history::update dict_history::next(const std::string& name,
+                                        const dict_snapshot& snapshot,
+                                        long resync_every, std::string& patch) {
+    entry& e = m_entries[name];
+    update u;
+    u.sequence = e.sequence++;
+    u.full = !e.last || resync_every <= 1 || u.sequence % resync_every == 0;
+    if (!u.full) {
+        write_patch(*e.last, snapshot, patch);
+    }
+    return u;
+}
+
+void dict_history::keep(const std::string& name, std::unique_ptr<dict_snapshot> snapshot) {
+    m_entries[name].last = std::move(snapshot);
+}
+
+} // namespace mx
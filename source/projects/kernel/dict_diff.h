@@ -0,0 +1,57 @@
+#pragma once
+
+// dict_history -- `dict` results sent as changes rather than whole documents.
+//
+// A patch that sends the same dictionary on every tick resends all of it each
+// time, though typically only a few values have moved. With @diff the server
+// thread keeps the last snapshot it published under each dictionary name and
+// publishes an RFC 6902 JSON Patch from that one to the next instead, with the
+// whole document every N updates so that a client that joins late, or missed
+// a message, catches up.
+//
+// Two snapshots with the same shape -- the same keys in the same order, the
+// same array lengths -- are compared record by record, and only the values
+// that differ are written out, as `replace` operations. Anything else falls
+// back to nl::json::diff over both documents. Either way, invalid UTF-8 in a
+// key or string is written as U+FFFD. Max-free.
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "dict_snapshot.h"
+
+namespace mx {
+
+// Writes the RFC 6902 patch from `from` to `to` into `out`, as compact JSON.
+void write_patch(const dict_snapshot& from, const dict_snapshot& to, std::string& out);
+
+class dict_history {
+public:
+    // What to publish for the next snapshot of a dictionary.
+    struct update {
+        bool full = true; // the whole document; otherwise the patch
+        long sequence = 0; // counts from 0 per dictionary name
+    };
+
+    // With resync_every of N, every Nth update of `name` is full, starting with
+    // the first; the rest get a patch against the previous one in `patch`.
+    update next(const std::string& name, const dict_snapshot& snapshot,
+                long resync_every, std::string& patch);
+
+    // The snapshot that was just published under `name`, for the next diff.
+    void keep(const std::string& name, std::unique_ptr<dict_snapshot> snapshot);
+
+    size_t size() const { return m_entries.size(); }
+    void clear() { m_entries.clear(); }
+
+private:
+    struct entry {
+        std::unique_ptr<dict_snapshot> last;
+        long sequence = 0;
+    };
+
+    std::unordered_map<std::string, entry> m_entries;
+};
+
+} // namespace mx
@@ -0,0 +1,288 @@
+#include "dict_encoding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "json_writer.h"
+
+namespace mx {
+
+namespace {
+
+// Both formats give a map or array's element count up front. A first replay
+// counts them, in the order the containers begin; the encoder's own replay
+// then takes one count per begin_object/begin_array.
+class container_counter {
+public:
+    explicit container_counter(std::vector<uint32_t>& counts) : m_counts(counts) {}
+
+    void begin_object() { open(true); }
+    void end_object() { m_open.pop_back(); }
+    void begin_array() { open(false); }
+    void end_array() { m_open.pop_back(); }
+
+    void key(std::string_view) { ++m_counts[m_open.back().index]; }
+
+    template <typename T>
+    void value(const T&) { element(); }
+    void null() { element(); }
+
+private:
+    struct open_container {
+        size_t index;
+        bool is_object;
+    };
+
+    // Values inside an object are counted by their keys.
+    void element() {
+        if (!m_open.empty() && !m_open.back().is_object) {
+            ++m_counts[m_open.back().index];
+        }
+    }
+
+    void open(bool is_object) {
+        element();
+        m_open.push_back({m_counts.size(), is_object});
+        m_counts.push_back(0);
+    }
+
+    std::vector<uint32_t>& m_counts;
+    std::vector<open_container> m_open;
+};
+
+// Shared by both encoders: big-endian writes and the count sequence.
+class binary_out {
+public:
+    binary_out(std::vector<char>& out, const std::vector<uint32_t>& counts)
+        : m_out(out), m_counts(counts) {}
+
+protected:
+    void byte(uint8_t b) { m_out.push_back(static_cast<char>(b)); }
+
+    template <typename T>
+    void big_endian(T value) {
+        for (int shift = static_cast<int>(sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+            byte(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void bytes(std::string_view text) { m_out.insert(m_out.end(), text.begin(), text.end()); }
+
+    void float64_bits(double value) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        big_endian(bits);
+    }
+
+    uint32_t next_count() { return m_counts[m_next++]; }
+
+    // Both formats' text strings are UTF-8, which a Max symbol need not be.
+    // Invalid bytes become U+FFFD, as json_writer writes them; valid text, the
+    // usual case, is returned as it is.
+    std::string_view valid_utf8(std::string_view text) {
+        const auto* const begin = reinterpret_cast<const unsigned char*>(text.data());
+        const auto* const end = begin + text.size();
+        const auto* p = begin;
+        while (p != end) {
+            const size_t length = *p < 0x80 ? 1 : utf8_sequence(p, end);
+            if (length == 0) {
+                break;
+            }
+            p += length;
+        }
+        if (p == end) {
+            return text;
+        }
+
+        m_repaired.assign(text.data(), static_cast<size_t>(p - begin));
+        while (p != end) {
+            const size_t length = *p < 0x80 ? 1 : utf8_sequence(p, end);
+            if (length == 0) {
+                m_repaired.append("\xEF\xBF\xBD"); // U+FFFD
+                ++p;
+            } else {
+                m_repaired.append(reinterpret_cast<const char*>(p), length);
+                p += length;
+            }
+        }
+        return m_repaired;
+    }
+
+private:
+    std::vector<char>& m_out;
+    const std::vector<uint32_t>& m_counts;
+    size_t m_next = 0;
+    std::string m_repaired;
+};
+
+// RFC 8949. Integers and lengths in their shortest form, as nl::json writes
+// them.
+class cbor_encoder : public binary_out {
+public:
+    using binary_out::binary_out;
+
+    void begin_object() { head(5, next_count()); }
+    void end_object() {}
+    void begin_array() { head(4, next_count()); }
+    void end_array() {}
+
+    void key(std::string_view name) { value(name); }
+
+    void value(std::string_view text) {
+        text = valid_utf8(text);
+        head(3, text.size());
+        bytes(text);
+    }
+    void value(long long number) {
+        if (number >= 0) {
+            head(0, static_cast<uint64_t>(number));
+        } else {
+            // -1 - n, computed without overflowing for the minimum.
+            head(1, ~static_cast<uint64_t>(number));
+        }
+    }
+    void value(double number) {
+        byte(0xFB);
+        float64_bits(number);
+    }
+    void value(bool flag) { byte(flag ? 0xF5 : 0xF4); }
+    void null() { byte(0xF6); }
+
+private:
+    void head(uint8_t major, uint64_t argument) {
+        const uint8_t type = static_cast<uint8_t>(major << 5);
+        if (argument < 24) {
+            byte(static_cast<uint8_t>(type | argument));
+        } else if (argument <= 0xFF) {
+            byte(type | 24);
+            byte(static_cast<uint8_t>(argument));
+        } else if (argument <= 0xFFFF) {
+            byte(type | 25);
+            big_endian(static_cast<uint16_t>(argument));
+        } else if (argument <= 0xFFFFFFFF) {
+            byte(type | 26);
+            big_endian(static_cast<uint32_t>(argument));
+        } else {
+            byte(type | 27);
+            big_endian(argument);
+        }
+    }
+};
+
+// The MessagePack specification, likewise shortest forms throughout.
+class msgpack_encoder : public binary_out {
+public:
+    using binary_out::binary_out;
+
+    void begin_object() { container(next_count(), 0x80, 0xDE); }
+    void end_object() {}
+    void begin_array() { container(next_count(), 0x90, 0xDC); }
+    void end_array() {}
+
+    void key(std::string_view name) { value(name); }
+
+    void value(std::string_view text) {
+        text = valid_utf8(text);
+        const size_t n = text.size();
+        if (n < 32) {
+            byte(static_cast<uint8_t>(0xA0 | n));
+        } else if (n <= 0xFF) {
+            byte(0xD9);
+            byte(static_cast<uint8_t>(n));
+        } else if (n <= 0xFFFF) {
+            byte(0xDA);
+            big_endian(static_cast<uint16_t>(n));
+        } else {
+            byte(0xDB);
+            big_endian(static_cast<uint32_t>(n));
+        }
+        bytes(text);
+    }
+    void value(long long number) {
+        if (number >= 0) {
+            const auto u = static_cast<uint64_t>(number);
+            if (u < 128) {
+                byte(static_cast<uint8_t>(u));
+            } else if (u <= 0xFF) {
+                byte(0xCC);
+                byte(static_cast<uint8_t>(u));
+            } else if (u <= 0xFFFF) {
+                byte(0xCD);
+                big_endian(static_cast<uint16_t>(u));
+            } else if (u <= 0xFFFFFFFF) {
+                byte(0xCE);
+                big_endian(static_cast<uint32_t>(u));
+            } else {
+                byte(0xCF);
+                big_endian(u);
+            }
+        } else if (number >= -32) {
+            byte(static_cast<uint8_t>(static_cast<int8_t>(number)));
+        } else if (number >= INT8_MIN) {
+            byte(0xD0);
+            byte(static_cast<uint8_t>(static_cast<int8_t>(number)));
+        } else if (number >= INT16_MIN) {
+            byte(0xD1);
+            big_endian(static_cast<uint16_t>(static_cast<int16_t>(number)));
+        } else if (number >= INT32_MIN) {
+            byte(0xD2);
+            big_endian(static_cast<uint32_t>(static_cast<int32_t>(number)));
+        } else {
+            byte(0xD3);
+            big_endian(static_cast<uint64_t>(number));
+        }
+    }
+    void value(double number) {
+        byte(0xCB);
+        float64_bits(number);
+    }
+    void value(bool flag) { byte(flag ? 0xC3 : 0xC2); }
+    void null() { byte(0xC0); }
+
+private:
+    // fix form below 16 elements, then 16- and 32-bit counts.
+    void container(uint32_t count, uint8_t fix, uint8_t wide16) {
+        if (count < 16) {
+            byte(static_cast<uint8_t>(fix | count));
+        } else if (count <= 0xFFFF) {
+            byte(wide16);
+            big_endian(static_cast<uint16_t>(count));
+        } else {
+            byte(static_cast<uint8_t>(wide16 + 1));
+            big_endian(count);
+        }
+    }
+};
+
+template <typename Encoder>
+void encode(const dict_snapshot& snapshot, std::vector<char>& out) {
+    std::vector<uint32_t> counts;
+    container_counter counter(counts);
+    snapshot.replay(counter);
+
+    Encoder encoder(out, counts);
+    snapshot.replay(encoder);
+}
+
+} // namespace
+
+dict_encoding encoding_for_mime_type(const std::string& mime) {
+    if (mime == mime_type(dict_encoding::cbor)) {
+        return dict_encoding::cbor;
+    }
+    if (mime == mime_type(dict_encoding::msgpack)) {
+        return dict_encoding::msgpack;
+    }
+    return dict_encoding::json;
+}
+
+void encode_cbor(const dict_snapshot& snapshot, std::vector<char>& out) {
+    encode<cbor_encoder>(snapshot, out);
+}
+
+void encode_msgpack(const dict_snapshot& snapshot, std::vector<char>& out) {
+    encode<msgpack_encoder>(snapshot, out);
+}
+
+} // namespace mx
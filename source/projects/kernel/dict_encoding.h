@@ -0,0 +1,44 @@
+#pragma once
+
+// Encodings for `dict` results, chosen with @encoding.
+//
+// JSON is text and travels in the message's data, as before. CBOR and
+// MessagePack are binary, so they travel as a buffer on the message, which
+// avoids pretty-printing, escaping and -- on the client -- parsing decimal
+// text: for a large, mostly numeric dictionary the payload is about two thirds
+// the size of compact JSON and under half the pretty-printed form.
+//
+// Both binary encoders replay a dict_snapshot directly, the way json_writer
+// does, with no nl::json document in between. They differ from nl::json's
+// to_cbor/to_msgpack only where the formats leave a choice: doubles are
+// always written as float64, and keys keep the dictionary's order. Invalid
+// UTF-8 in keys and strings is replaced with U+FFFD, as json_writer replaces
+// it, rather than copied into a text string no decoder should accept.
+// Max-free.
+
+#include <string>
+#include <vector>
+
+#include "dict_snapshot.h"
+
+namespace mx {
+
+enum class dict_encoding { json, cbor, msgpack };
+
+inline const char* mime_type(dict_encoding e) {
+    switch (e) {
+    case dict_encoding::json:    return "application/json";
+    case dict_encoding::cbor:    return "application/cbor";
+    case dict_encoding::msgpack: return "application/msgpack";
+    }
+    return "application/json";
+}
+
+// The encoding a mime type names, or json for anything else.
+dict_encoding encoding_for_mime_type(const std::string& mime);
+
+// Append the snapshot in the binary encoding to `out`.
+void encode_cbor(const dict_snapshot& snapshot, std::vector<char>& out);
+void encode_msgpack(const dict_snapshot& snapshot, std::vector<char>& out);
+
+} // namespace mx
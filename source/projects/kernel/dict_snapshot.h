@@ -0,0 +1,121 @@
+#pragma once
+
+// dict_snapshot -- a Max dictionary copied out flat, to be encoded later.
+//
+// `dict` runs on whichever thread sent it, usually Max's main thread, and the
+// dictionary stays retained until the walk is done. Encoding JSON during the
+// walk put the whole encoder on that thread. Instead the walk records what it
+// finds here -- one table of tagged records, and every key and string in one
+// byte buffer -- and releases the dictionary. The server thread replays the
+// snapshot into a json_writer when it publishes the result.
+//
+// The calls are json_writer's, so the same walk can feed either, and so can
+// replay(). Max-free.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace mx {
+
+class dict_snapshot {
+public:
+    void begin_object() { add(kind::begin_object); }
+    void end_object() { add(kind::end_object); }
+    void begin_array() { add(kind::begin_array); }
+    void end_array() { add(kind::end_array); }
+
+    void key(std::string_view name) { add_text(kind::key, name); }
+
+    void value(std::string_view text) { add_text(kind::string, text); }
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(int number) { value(static_cast<long long>(number)); }
+    void value(long number) { value(static_cast<long long>(number)); }
+    void value(long long number) {
+        record r(kind::integer);
+        r.integer = number;
+        m_records.push_back(r);
+    }
+    void value(double number) {
+        record r(kind::real);
+        r.real = number;
+        m_records.push_back(r);
+    }
+    void value(bool flag) { add(flag ? kind::true_value : kind::false_value); }
+    void null() { add(kind::null); }
+
+    // Make the same calls, in order, on `out`.
+    template <typename Out>
+    void replay(Out& out) const {
+        for (const record& r : m_records) {
+            switch (r.type) {
+            case kind::begin_object: out.begin_object(); break;
+            case kind::end_object:   out.end_object(); break;
+            case kind::begin_array:  out.begin_array(); break;
+            case kind::end_array:    out.end_array(); break;
+            case kind::key:          out.key(text(r)); break;
+            case kind::string:       out.value(text(r)); break;
+            case kind::integer:      out.value(r.integer); break;
+            case kind::real:         out.value(r.real); break;
+            case kind::true_value:   out.value(true); break;
+            case kind::false_value:  out.value(false); break;
+            case kind::null:         out.null(); break;
+            }
+        }
+    }
+
+    // Records, and bytes of key and string text.
+    size_t size() const { return m_records.size(); }
+    size_t text_bytes() const { return m_text.size(); }
+    bool empty() const { return m_records.empty(); }
+
+    void clear() {
+        m_records.clear();
+        m_text.clear();
+    }
+
+    // Record by record, for comparing two snapshots without replaying them
+    // (dict_diff.h). Each payload accessor is only meaningful for its kinds.
+    enum class kind : uint8_t {
+        begin_object, end_object, begin_array, end_array,
+        key, string, integer, real, true_value, false_value, null,
+    };
+
+    kind kind_at(size_t i) const { return m_records[i].type; }
+    std::string_view text_at(size_t i) const { return text(m_records[i]); }
+    long long integer_at(size_t i) const { return m_records[i].integer; }
+    double real_at(size_t i) const { return m_records[i].real; }
+
+private:
+
+    struct record {
+        kind type;
+        uint32_t length = 0; // key and string: bytes
+        union {
+            size_t offset; // key and string: start in m_text
+            long long integer;
+            double real;
+        };
+        explicit record(kind k) : type(k), offset(0) {}
+    };
+
+    void add(kind k) { m_records.emplace_back(k); }
+
+    void add_text(kind k, std::string_view text) {
+        record r(k);
+        r.length = static_cast<uint32_t>(text.size());
+        r.offset = m_text.size();
+        m_text.insert(m_text.end(), text.begin(), text.end());
+        m_records.push_back(r);
+    }
+
+    std::string_view text(const record& r) const {
+        return std::string_view(m_text.data() + r.offset, r.length);
+    }
+
+    std::vector<record> m_records;
+    std::vector<char> m_text;
+};
+
+} // namespace mx
@@ -10,11 +10,14 @@
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <memory>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include "xeus/xkernel.hpp"
 #include "xeus/xkernel_configuration.hpp"
@@ -23,13 +26,31 @@
 #include "nlohmann/json.hpp"
 
 #include "connection.h"
+#include "atom_text.h"
 #include "interpreter.h"
+#include "dict_encoding.h"
+#include "dict_snapshot.h"
+#include "symbol_cache.h"
+#include "typed_array.h"
 #include "types.h"
 #include "version.h"
 
 using namespace xeus;
 namespace nl = nlohmann;
 
+// Dictionaries holding cell sources with @delivery dict, one for each cell
+// the patch may still be reading. A cell's dictionary is kept until the cell
+// has completed, then cleared and handed to a later cell. Main thread only.
+struct cell_dictionaries {
+    struct entry {
+        int cell = 0;
+        t_dictionary* dict = nullptr;
+        t_symbol* name = nullptr;
+    };
+    std::deque<entry> live; // in the order the cells were delivered
+    std::vector<entry> spare;
+};
+
 // ---------------------------------------------------------------------------
 // t_kernel: Max-visible C struct
 // ---------------------------------------------------------------------------
@@ -40,8 +61,31 @@ typedef struct _kernel {
     t_symbol* name;
     long debug;
     long timeout;
+    long concurrency;
+    long iopub_msg_rate;
+    long iopub_data_rate;
+    t_symbol* delivery;
+    long tokenize;
+    t_symbol* encoding;
+    long diff;
     mx::t_kernel_impl* impl;
     void* outlet_qelem;
+    // With @delivery dict, cell sources go in these and `info` in the one
+    // below, so dictionary names are the only symbols they intern. Created on
+    // first use.
+    cell_dictionaries* cell_dicts;
+    t_dictionary* info_dict;
+    t_symbol* info_dict_name;
+    // Bytes of the distinct symbols this object has interned for variable
+    // text: cell sources, `info` JSON, and the like. Symbols are never freed,
+    // so this is how much the object can have grown Max's symbol table. A
+    // text interned again is not counted again; one that already existed is
+    // counted the first time this object interns it.
+    long long symbol_bytes;
+    std::unordered_set<const t_symbol*>* interned;
+    // Symbols the outlet drain has already interned, so recurring selectors
+    // and short words skip gensym. Main thread only.
+    mx::symbol_cache<t_symbol>* symbols;
 } t_kernel;
 
 // ---------------------------------------------------------------------------
@@ -58,6 +102,7 @@ void kernel_info(t_kernel* x);
 void kernel_result(t_kernel* x, t_symbol* s, long argc, t_atom* argv);
 void kernel_print(t_kernel* x, t_symbol* s, long argc, t_atom* argv);
 void kernel_dict(t_kernel* x, t_symbol* s);
+void kernel_cell(t_kernel* x, t_symbol* s, long argc, t_atom* argv);
 void kernel_install(t_kernel* x);
 void kernel_outlet_drain(t_kernel* x);
 
@@ -70,46 +115,131 @@ static t_class* kernel_class = nullptr;
 // Helpers
 // ---------------------------------------------------------------------------
 
+// gensym for text that varies -- anything but a fixed selector or key. Every
+// distinct string passed to gensym stays in Max's symbol table until Max
+// quits, so these are counted (+1 for the terminator), once per symbol.
+// `terminated` must be NUL-terminated in place, as a symbol in an
+// OutletMessage is, so it need not be copied first.
+static t_symbol* intern_text(t_kernel* x, std::string_view terminated) {
+    t_symbol* s = gensym(terminated.data());
+    if (x->interned && x->interned->insert(s).second) {
+        x->symbol_bytes += static_cast<long long>(terminated.size()) + 1;
+    }
+    return s;
+}
+
+static t_symbol* intern_text(t_kernel* x, const std::string& text) {
+    return intern_text(x, std::string_view(text.c_str(), text.size()));
+}
+
+// A dictionary registered under a name Max assigns, created on first use and
+// cleared for each reuse.
+static t_dictionary* reuse_dictionary(t_dictionary** slot, t_symbol** name) {
+    if (!*slot) {
+        t_symbol* assigned = nullptr;
+        *slot = dictobj_register(dictionary_new(), &assigned);
+        *name = assigned;
+    }
+    dictionary_clear(*slot);
+    return *slot;
+}
+
+// The dictionary for `cell`'s source. Cells are delivered in order and the
+// oldest one still waiting is current_execution, so every cell delivered
+// before it has completed and its dictionary can be reused. A fire-and-forget
+// cell completes as it is delivered, so its dictionary lasts until the next
+// cell arrives.
+static const cell_dictionaries::entry& dictionary_for_cell(t_kernel* x, int cell) {
+    cell_dictionaries& dicts = *x->cell_dicts;
+    const int oldest = x->impl->current_execution.load();
+    while (!dicts.live.empty() && (oldest == 0 || dicts.live.front().cell < oldest)) {
+        dicts.spare.push_back(dicts.live.front());
+        dicts.live.pop_front();
+    }
+
+    cell_dictionaries::entry e;
+    if (!dicts.spare.empty()) {
+        e = dicts.spare.back();
+        dicts.spare.pop_back();
+        dictionary_clear(e.dict);
+    } else {
+        e.dict = dictobj_register(dictionary_new(), &e.name);
+    }
+    e.cell = cell;
+    dicts.live.push_back(e);
+    return dicts.live.back();
+}
+
+// Every cell is done with its dictionary: on start, counters begin again.
+static void release_cell_dictionaries(t_kernel* x) {
+    cell_dictionaries& dicts = *x->cell_dicts;
+    dicts.spare.insert(dicts.spare.end(), dicts.live.begin(), dicts.live.end());
+    dicts.live.clear();
+}
+
+// The encoding @encoding names; json for anything unrecognised.
+static mx::dict_encoding dict_encoding_of(t_kernel* x) {
+    if (x->encoding == gensym("cbor")) return mx::dict_encoding::cbor;
+    if (x->encoding == gensym("msgpack")) return mx::dict_encoding::msgpack;
+    return mx::dict_encoding::json;
+}
+
+static bool deliver_as_dict(t_kernel* x) {
+    return x->delivery == x->symbols->lookup("dict");
+}
+
 // Concatenate a Max argument list into a single space-separated string.
 // Atoms that are neither symbol, int nor float are reported and skipped.
+// Formatted by atom_text_writer: locale-free, and floats keep every digit
+// they need rather than a stream's default six.
 static std::string atoms_to_string(t_object* owner, long argc, t_atom* argv,
                                    long start = 0) {
-    std::stringstream ss;
-    bool first = true;
-
-    for (long i = start; i < argc; i++) {
-        const short type = atom_gettype(argv + i);
-        if (type != A_SYM && type != A_LONG && type != A_FLOAT) {
-            object_warn(owner, "ignoring unsupported atom at index %ld", i);
-            continue;
-        }
-
-        if (!first) ss << " ";
-        first = false;
-
-        if (type == A_SYM) {
-            ss << atom_getsym(argv + i)->s_name;
-        } else if (type == A_LONG) {
-            ss << atom_getlong(argv + i);
-        } else {
-            ss << atom_getfloat(argv + i);
-        }
+    std::string text;
+    if (start >= argc) {
+        return text;
     }
+    // Enough for most lists of numbers and short words in one allocation.
+    text.reserve(static_cast<size_t>(argc - start) * 12);
+
+    mx::format_atoms(text, argv + start, argv + argc,
+                     [owner, argv](const t_atom& atom, mx::atom_text_writer& writer) {
+        const t_atom* a = &atom;
+        switch (atom_gettype(a)) {
+        case A_SYM:
+            writer.symbol(atom_getsym(a)->s_name);
+            break;
+        case A_LONG:
+            writer.integer(atom_getlong(a));
+            break;
+        case A_FLOAT:
+            writer.real(atom_getfloat(a));
+            break;
+        default:
+            object_warn(owner, "ignoring unsupported atom at index %ld",
+                        static_cast<long>(a - argv));
+            break;
+        }
+    });
 
-    return ss.str();
+    return text;
 }
 
 // Queue a message for a cell, or as free-standing output when no cell is
 // waiting. Results that arrive outside an execution used to be delivered as
 // the answer to whichever cell ran next; routing them to the async queue keeps
 // the text without letting it masquerade as a result.
-static void queue_for_jupyter(t_kernel* x, mx::ResultMessage result) {
+//
+// `cell` is the counter the patch named with `cell <n> ...`, or 0 to answer
+// the oldest cell in flight. A named cell that is no longer in flight is
+// discarded by the interpreter like any other stale reply.
+static void queue_for_jupyter(t_kernel* x, mx::ResultMessage result, int cell = 0) {
     auto* impl = x->impl;
-    const int pending = impl->current_execution.load();
+    const int pending = cell != 0 ? cell : impl->current_execution.load();
 
     if (pending != 0) {
         result.execution_counter = pending;
         impl->result_queue.push(std::move(result));
+        impl->wake_server();
         return;
     }
 
@@ -128,6 +258,7 @@ static void queue_for_jupyter(t_kernel* x, mx::ResultMessage result) {
     }
 
     impl->async_queue.push(std::move(result));
+    impl->wake_server();
 }
 
 // ---------------------------------------------------------------------------
@@ -151,6 +282,7 @@ void ext_main(void* r) {
     class_addmethod(c, (method)kernel_result,  "result",  A_GIMME, 0);
     class_addmethod(c, (method)kernel_print,   "print",   A_GIMME, 0);
     class_addmethod(c, (method)kernel_dict,    "dict",    A_SYM,   0);
+    class_addmethod(c, (method)kernel_cell,    "cell",    A_GIMME, 0);
     class_addmethod(c, (method)kernel_install, "install", 0);
 
     CLASS_ATTR_SYM(c, "name", 0, t_kernel, name);
@@ -165,6 +297,34 @@ void ext_main(void* r) {
     CLASS_ATTR_LABEL(c, "timeout", 0, "Result Timeout (seconds, 0 = do not wait)");
     CLASS_ATTR_BASIC(c, "timeout", 0);
 
+    CLASS_ATTR_LONG(c, "concurrency", 0, t_kernel, concurrency);
+    CLASS_ATTR_LABEL(c, "concurrency", 0, "Cells In Flight (1 = one at a time)");
+    CLASS_ATTR_FILTER_MIN(c, "concurrency", 1);
+
+    CLASS_ATTR_LONG(c, "iopub_msg_rate", 0, t_kernel, iopub_msg_rate);
+    CLASS_ATTR_LABEL(c, "iopub_msg_rate", 0, "Output Messages per Second (0 = unlimited)");
+    CLASS_ATTR_FILTER_MIN(c, "iopub_msg_rate", 0);
+
+    CLASS_ATTR_LONG(c, "iopub_data_rate", 0, t_kernel, iopub_data_rate);
+    CLASS_ATTR_LABEL(c, "iopub_data_rate", 0, "Output Bytes per Second (0 = unlimited)");
+    CLASS_ATTR_FILTER_MIN(c, "iopub_data_rate", 0);
+
+    CLASS_ATTR_SYM(c, "delivery", 0, t_kernel, delivery);
+    CLASS_ATTR_LABEL(c, "delivery", 0, "Cell Delivery");
+    CLASS_ATTR_ENUM(c, "delivery", 0, "symbol dict");
+
+    CLASS_ATTR_LONG(c, "tokenize", 0, t_kernel, tokenize);
+    CLASS_ATTR_LABEL(c, "tokenize", 0, "Split Cells into Atoms");
+    CLASS_ATTR_STYLE(c, "tokenize", 0, "onoff");
+
+    CLASS_ATTR_SYM(c, "encoding", 0, t_kernel, encoding);
+    CLASS_ATTR_LABEL(c, "encoding", 0, "Dictionary Encoding");
+    CLASS_ATTR_ENUM(c, "encoding", 0, "json cbor msgpack");
+
+    CLASS_ATTR_LONG(c, "diff", 0, t_kernel, diff);
+    CLASS_ATTR_LABEL(c, "diff", 0, "Dictionary Changes, Full Every N (0 = off)");
+    CLASS_ATTR_FILTER_MIN(c, "diff", 0);
+
     class_register(CLASS_BOX, c);
     kernel_class = c;
 
@@ -186,8 +346,21 @@ void* kernel_new(t_symbol* s, long argc, t_atom* argv) {
     x->name = gensym("");
     x->debug = 0;
     x->timeout = 30;
+    x->concurrency = 1;
+    x->iopub_msg_rate = 1000;
+    x->iopub_data_rate = 1000000;
+    x->delivery = gensym("symbol");
+    x->tokenize = 0;
+    x->encoding = gensym("json");
+    x->diff = 0;
     x->impl = nullptr;
     x->outlet_qelem = nullptr;
+    x->cell_dicts = nullptr;
+    x->info_dict = nullptr;
+    x->info_dict_name = nullptr;
+    x->symbol_bytes = 0;
+    x->interned = nullptr;
+    x->symbols = nullptr;
 
     // Process attributes from object box args
     attr_args_process(x, argc, argv);
@@ -196,8 +369,21 @@ void* kernel_new(t_symbol* s, long argc, t_atom* argv) {
     // The interpreter is created in kernel_start, not here: starting the kernel
     // moves it into the xkernel, so a single instance cannot survive a restart.
     try {
+        x->cell_dicts = new cell_dictionaries();
+        x->interned = new std::unordered_set<const t_symbol*>();
+
+        // A miss interns through intern_text, so what the drain adds to the
+        // symbol table is counted once per distinct short word.
+        x->symbols = new mx::symbol_cache<t_symbol>(
+            [x](const char* text) { return intern_text(x, std::string_view(text)); });
+
         auto impl = std::make_unique<mx::t_kernel_impl>();
         impl->timeout.store(x->timeout);
+        impl->concurrency.store(x->concurrency);
+        impl->iopub_msg_rate_limit.store(x->iopub_msg_rate);
+        impl->iopub_data_rate_limit.store(x->iopub_data_rate);
+        impl->tokenize.store(x->tokenize != 0);
+        impl->dict_diff.store(x->diff);
 
         x->outlet_qelem = qelem_new(x, (method)kernel_outlet_drain);
         if (!x->outlet_qelem) {
@@ -221,13 +407,38 @@ void* kernel_new(t_symbol* s, long argc, t_atom* argv) {
     return x;
 }
 
+static void free_dictionaries(t_kernel* x) {
+    if (x->cell_dicts) {
+        release_cell_dictionaries(x);
+        for (const auto& e : x->cell_dicts->spare) {
+            object_free(e.dict);
+        }
+        delete x->cell_dicts;
+        x->cell_dicts = nullptr;
+    }
+    if (x->info_dict) {
+        object_free(x->info_dict);
+        x->info_dict = nullptr;
+    }
+}
+
+static void free_symbol_cache(t_kernel* x) {
+    delete x->symbols;
+    x->symbols = nullptr;
+    delete x->interned;
+    x->interned = nullptr;
+}
+
 void kernel_free(t_kernel* x) {
+    free_dictionaries(x);
+
     auto* impl = x->impl;
     if (!impl) {
         if (x->outlet_qelem) {
             qelem_free(x->outlet_qelem);
             x->outlet_qelem = nullptr;
         }
+        free_symbol_cache(x);
         return;
     }
 
@@ -249,6 +460,9 @@ void kernel_free(t_kernel* x) {
         x->outlet_qelem = nullptr;
     }
 
+    // The qelem is gone, so the drain cannot run again.
+    free_symbol_cache(x);
+
     if (!impl->connection_file.empty()) {
         std::remove(impl->connection_file.c_str());
     }
@@ -272,31 +486,66 @@ void kernel_outlet_drain(t_kernel* x) {
     auto* impl = x->impl;
     if (!impl) return;
 
-    // Drain all pending outlet messages
-    while (true) {
-        auto msg = impl->outlet_queue.try_pop();
-        if (!msg.has_value()) break;
-
-        const mx::OutletMessage& m = msg.value();
-
-        // Convert AtomValue vector to t_atom array
-        std::vector<t_atom> atoms(m.atoms.size());
-        for (size_t i = 0; i < m.atoms.size(); ++i) {
-            const auto& val = m.atoms[i];
-            if (std::holds_alternative<std::string>(val)) {
-                atom_setsym(&atoms[i], gensym(std::get<std::string>(val).c_str()));
-            } else if (std::holds_alternative<long>(val)) {
-                atom_setlong(&atoms[i], std::get<long>(val));
-            } else if (std::holds_alternative<double>(val)) {
-                atom_setfloat(&atoms[i], std::get<double>(val));
+    impl->clear_notify_pending();
+
+    // A budget's worth at a time, so a backlog cannot hold up Max's UI. If
+    // anything is left, run again once Max has had its turn.
+    auto& symbols = *x->symbols;
+    const bool more = impl->outlet_drain.run(
+        impl->outlet_queue, [x, impl, &symbols](mx::OutletMessage& m) {
+            const bool as_dict = deliver_as_dict(x);
+
+            // Convert the flat atom table to t_atoms. A cell fits the stack
+            // buffer unless @tokenize split it into more than that; only then
+            // does this allocate.
+            constexpr size_t k_stack_atoms = 32;
+            t_atom stack_atoms[k_stack_atoms];
+            std::vector<t_atom> heap_atoms;
+            t_atom* atoms = stack_atoms;
+            if (m.size() + 1 > k_stack_atoms) {
+                heap_atoms.resize(m.size() + 1);
+                atoms = heap_atoms.data();
             }
-        }
 
-        void* outlet = (m.outlet_index == 0) ? x->outlet_left : x->outlet_right;
-        if (outlet) {
-            outlet_anything(outlet, gensym(m.selector.c_str()),
-                            static_cast<long>(atoms.size()), atoms.data());
-        }
+            long argc = 0;
+            for (size_t i = 0; i < m.size(); ++i) {
+                switch (m.tag(i)) {
+                case mx::atom_tag::symbol:
+                    if (static_cast<int>(i) == m.body_index && as_dict) {
+                        // The cell's source goes in a dictionary, which holds
+                        // it as a string, and the patch gets
+                        // `dictionary <name>`.
+                        const auto& e = dictionary_for_cell(x, m.execution_counter);
+                        dictionary_appendstring(e.dict, symbols.lookup("code"), m.symbol_cstr(i));
+                        dictionary_appendlong(e.dict, symbols.lookup("cell"), m.execution_counter);
+                        atom_setsym(&atoms[argc++], symbols.lookup("dictionary"));
+                        atom_setsym(&atoms[argc++], e.name);
+                    } else {
+                        // Short words -- "execute", and with @tokenize the
+                        // patch's vocabulary -- come from the cache; long
+                        // text goes to gensym every time.
+                        atom_setsym(&atoms[argc++], symbols.lookup(m.symbol(i)));
+                    }
+                    break;
+                case mx::atom_tag::integer:
+                    atom_setlong(&atoms[argc++], m.integer(i));
+                    break;
+                case mx::atom_tag::real:
+                    atom_setfloat(&atoms[argc++], m.real(i));
+                    break;
+                }
+            }
+
+            void* outlet = (m.outlet_index == 0) ? x->outlet_left : x->outlet_right;
+            if (outlet) {
+                outlet_anything(outlet, symbols.selector(m.selector), argc, atoms);
+            }
+
+            impl->recycle(std::move(m));
+        });
+
+    if (more && x->outlet_qelem) {
+        qelem_set((t_qelem*)x->outlet_qelem);
     }
 }
 
@@ -337,6 +586,7 @@ static bool kernel_shutdown(t_kernel* x, std::chrono::milliseconds limit) {
     // Release any cell that is mid-wait, so the server thread can return to
     // its loop instead of sitting out the full result timeout.
     impl->shutdown_requested.store(true);
+    impl->wake_server();
 
     // Give the server loop a moment to answer cells that are still in flight.
     // Stopping first would leave those clients waiting on a reply that can
@@ -366,6 +616,10 @@ static bool kernel_shutdown(t_kernel* x, std::chrono::milliseconds limit) {
         }
     }
 
+    // The server is about to be destroyed or abandoned; either way nothing may
+    // wake it from here on.
+    impl->clear_server_waker();
+
     if (impl->kernel_thread) {
         if (finished) {
             if (impl->kernel_thread->joinable()) {
@@ -414,10 +668,18 @@ void kernel_start(t_kernel* x) {
     try {
         // Re-arm state so a restart behaves like a fresh start.
         impl->timeout.store(x->timeout);
+        impl->concurrency.store(x->concurrency);
+        impl->iopub_msg_rate_limit.store(x->iopub_msg_rate);
+        impl->iopub_data_rate_limit.store(x->iopub_data_rate);
+        impl->tokenize.store(x->tokenize != 0);
+        impl->dict_diff.store(x->diff);
         impl->shutdown_requested.store(false);
         impl->alive.store(true);
         impl->thread_finished.store(false);
         impl->current_execution.store(0);
+        if (x->cell_dicts) {
+            release_cell_dictionaries(x);
+        }
         impl->result_queue.clear();
         impl->async_queue.clear();
 
@@ -453,18 +715,20 @@ void kernel_start(t_kernel* x) {
         // Get actual bound ports
         impl->kernel->get_server().update_config(config);
 
-        // Drive the server loop's idle tick. The poll timeout bounds how long
-        // `stop` takes to be noticed; the callback is what lets Max-initiated
-        // output reach a client while no cell is running, since IOPub may only
-        // be published from the thread that owns the socket.
+        // Drive the server loop's idle tick. The callback is what lets
+        // Max-initiated output reach a client, since IOPub may only be
+        // published from the thread that owns the socket. Pushing a result or
+        // `print` wakes the loop straight into it, so the poll timeout is only
+        // a safety net -- it paces cell deadlines, nothing waits on it.
         auto* server = dynamic_cast<xserver_zmq*>(&impl->kernel->get_server());
         if (server) {
-            server->set_poll_timeout(50);
+            server->set_poll_timeout(250);
             server->set_idle_callback([impl]() {
                 if (impl->interpreter_view) {
                     impl->interpreter_view->on_idle();
                 }
             });
+            impl->set_server_waker([server]() { server->wake(); });
         } else {
             object_warn((t_object*)x,
                         "unexpected server type; idle output disabled");
@@ -499,7 +763,7 @@ void kernel_start(t_kernel* x) {
         if (x->outlet_right) {
             t_atom atoms[2];
             atom_setsym(&atoms[0], gensym("connection_file"));
-            atom_setsym(&atoms[1], gensym(impl->connection_file.c_str()));
+            atom_setsym(&atoms[1], intern_text(x, impl->connection_file));
             outlet_anything(x->outlet_right, gensym("started"), 2, atoms);
         }
 
@@ -509,6 +773,7 @@ void kernel_start(t_kernel* x) {
         // Cleanup on failure. The kernel thread has not been launched yet at any
         // point where this can throw, so the kernel can be destroyed normally --
         // its publisher and heartbeat threads only exist once start() runs.
+        impl->clear_server_waker();
         impl->interpreter_view = nullptr;
         impl->kernel.reset();
         impl->context.reset();
@@ -586,22 +851,59 @@ void kernel_info(t_kernel* x) {
     // kernel_info_request is only available when the interpreter is registered
     // and the kernel is running. Use the static info instead.
     try {
+        // Counted by the server, so only since the last `start`.
+        auto* server = impl->kernel
+            ? dynamic_cast<xserver_zmq*>(&impl->kernel->get_server()) : nullptr;
+        const size_t rejected = server ? server->rejected_messages() : 0;
+
         nl::json info;
         info["implementation"] = "max_kernel";
         info["implementation_version"] = MX_KERNEL_VERSION;
         info["language"] = "max";
         info["running"] = (impl->kernel != nullptr);
+        info["suppressed_messages"] = impl->suppressed_messages.load();
+        info["suppressed_bytes"] = impl->suppressed_bytes.load();
+        info["dropped_from_max"] =
+            impl->result_queue.dropped() + impl->async_queue.dropped();
+        info["symbol_bytes"] = x->symbol_bytes;
+        info["symbol_cache_hits"] = x->symbols ? x->symbols->hits() : 0;
+        info["rejected_messages"] = rejected;
 
         object_post((t_object*)x, "=== Kernel Info ===");
         object_post((t_object*)x, "Implementation: max_kernel");
         object_post((t_object*)x, "Version: %s", MX_KERNEL_VERSION);
         object_post((t_object*)x, "Language: max");
         object_post((t_object*)x, "Running: %s", impl->kernel ? "yes" : "no");
-
-        if (x->outlet_right) {
+        object_post((t_object*)x, "Suppressed output: %lld messages / %lld bytes",
+                    impl->suppressed_messages.load(), impl->suppressed_bytes.load());
+        object_post((t_object*)x, "Dropped from Max (queue full): %zu",
+                    impl->result_queue.dropped() + impl->async_queue.dropped());
+        object_post((t_object*)x, "Symbols interned: %lld bytes", x->symbol_bytes);
+        object_post((t_object*)x, "Symbol cache hits: %zu",
+                    x->symbols ? x->symbols->hits() : size_t(0));
+        object_post((t_object*)x, "Rejected messages (bad signature): %zu", rejected);
+
+        if (x->outlet_right && deliver_as_dict(x)) {
+            // The counters change between calls, so as JSON every `info`
+            // would intern a new symbol.
+            t_dictionary* d = reuse_dictionary(&x->info_dict, &x->info_dict_name);
+            for (const auto& item : info.items()) {
+                t_symbol* key = gensym(item.key().c_str());
+                if (item.value().is_string()) {
+                    dictionary_appendstring(d, key, item.value().get<std::string>().c_str());
+                } else {
+                    dictionary_appendlong(d, key, item.value().get<long long>());
+                }
+            }
+            t_atom atoms[3];
+            atom_setsym(&atoms[0], gensym("info"));
+            atom_setsym(&atoms[1], gensym("dictionary"));
+            atom_setsym(&atoms[2], x->info_dict_name);
+            outlet_anything(x->outlet_right, gensym("kernel"), 3, atoms);
+        } else if (x->outlet_right) {
             t_atom atoms[2];
             atom_setsym(&atoms[0], gensym("info"));
-            atom_setsym(&atoms[1], gensym(info.dump().c_str()));
+            atom_setsym(&atoms[1], intern_text(x, info.dump()));
             outlet_anything(x->outlet_right, gensym("kernel"), 2, atoms);
         }
 
@@ -613,7 +915,83 @@ void kernel_info(t_kernel* x) {
 // ---------------------------------------------------------------------------
 // kernel_result -- reply from a Max patch to the cell that is executing
 // ---------------------------------------------------------------------------
-void kernel_result(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
+// Append numeric atoms to an array result. Anything else is an error: an
+// array with a hole in it would misplace every value after the hole.
+static bool pack_atoms(t_kernel* x, long argc, t_atom* argv, mx::typed_array& out) {
+    for (long i = 0; i < argc; i++) {
+        switch (atom_gettype(argv + i)) {
+        case A_LONG:
+            out.add(static_cast<long long>(atom_getlong(argv + i)));
+            break;
+        case A_FLOAT:
+            out.add(static_cast<double>(atom_getfloat(argv + i)));
+            break;
+        default:
+            object_error((t_object*)x, "result array: element %ld is not a number", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// The entry `key` of a registered dictionary, as an array result: a list of
+// numbers is one-dimensional, and a list of equal-length lists of numbers
+// two-dimensional.
+static bool pack_dict_array(t_kernel* x, t_symbol* name, t_symbol* key,
+                            mx::typed_array& out) {
+    t_dictionary* dict = dictobj_findregistered_retain(name);
+    if (!dict) {
+        object_error((t_object*)x, "dictionary '%s' not found", name->s_name);
+        return false;
+    }
+
+    long ac = 0;
+    t_atom* av = nullptr;
+    bool ok = dictionary_getatoms(dict, key, &ac, &av) == MAX_ERR_NONE;
+    if (!ok) {
+        object_error((t_object*)x, "dictionary '%s' has no entry '%s'",
+                     name->s_name, key->s_name);
+    } else if (ac > 0 && atom_gettype(av) == A_OBJ) {
+        long columns = -1;
+        for (long row = 0; ok && row < ac; row++) {
+            t_object* o = (t_object*)atom_getobj(av + row);
+            long rc = 0;
+            t_atom* rv = nullptr;
+            if (!o || object_classname(o) != gensym("atomarray")
+                || atomarray_getatoms((t_atomarray*)o, &rc, &rv) != MAX_ERR_NONE
+                || (columns >= 0 && rc != columns)) {
+                object_error((t_object*)x,
+                             "result array: '%s' is not a list of equal-length lists",
+                             key->s_name);
+                ok = false;
+                break;
+            }
+            columns = rc;
+            ok = pack_atoms(x, rc, rv, out);
+        }
+        if (ok) {
+            out.set_shape({static_cast<size_t>(ac), static_cast<size_t>(columns)});
+        }
+    } else {
+        ok = pack_atoms(x, ac, av, out);
+    }
+
+    dictobj_release(dict);
+    return ok;
+}
+
+static bool pack_array_result(t_kernel* x, long argc, t_atom* argv, mx::typed_array& out) {
+    if (argc >= 1 && atom_gettype(argv) == A_SYM && atom_getsym(argv) == gensym("dict")) {
+        if (argc != 3 || atom_gettype(argv + 1) != A_SYM || atom_gettype(argv + 2) != A_SYM) {
+            object_error((t_object*)x, "result array dict expects <dict-name> <key>");
+            return false;
+        }
+        return pack_dict_array(x, atom_getsym(argv + 1), atom_getsym(argv + 2), out);
+    }
+    return pack_atoms(x, argc, argv, out);
+}
+
+static void post_result(t_kernel* x, long argc, t_atom* argv, int cell) {
     auto* impl = x->impl;
     if (!impl) {
         object_error((t_object*)x, "not initialized");
@@ -637,21 +1015,32 @@ void kernel_result(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
             result.error_name = "MaxError";
         }
         result.error_value = atoms_to_string((t_object*)x, argc, argv, 2);
+    } else if (atom_gettype(argv) == A_SYM && atom_getsym(argv) == gensym("array")) {
+        // "result array <numbers...>" and "result array dict <name> <key>"
+        // publish the numbers as a binary buffer instead of text.
+        result.array = std::make_unique<mx::typed_array>();
+        if (!pack_array_result(x, argc - 1, argv + 1, *result.array)) {
+            return;
+        }
     } else {
         result.text = atoms_to_string((t_object*)x, argc, argv);
     }
 
-    queue_for_jupyter(x, std::move(result));
+    queue_for_jupyter(x, std::move(result), cell);
 
     if (x->debug) {
         object_post((t_object*)x, "result queued");
     }
 }
 
+void kernel_result(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
+    post_result(x, argc, argv, 0);
+}
+
 // ---------------------------------------------------------------------------
 // kernel_print -- stream output from Max to the connected client
 // ---------------------------------------------------------------------------
-void kernel_print(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
+static void post_print(t_kernel* x, long argc, t_atom* argv, int cell) {
     auto* impl = x->impl;
     if (!impl) {
         object_error((t_object*)x, "not initialized");
@@ -678,44 +1067,58 @@ void kernel_print(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
     out.stream_name = stream;
     out.text = atoms_to_string((t_object*)x, argc, argv, start);
 
-    const int pending = impl->current_execution.load();
+    const int pending = cell != 0 ? cell : impl->current_execution.load();
     if (pending != 0) {
         out.execution_counter = pending;
         impl->result_queue.push(std::move(out));
     } else {
         impl->async_queue.push(std::move(out));
     }
+    impl->wake_server();
+}
+
+void kernel_print(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
+    post_print(x, argc, argv, 0);
 }
 
 // ---------------------------------------------------------------------------
 // kernel_dict -- serialize a Max dict to JSON and send it as a result
 // ---------------------------------------------------------------------------
 
-// Convert one Max atom to its JSON equivalent.
-static nl::json atom_to_json(t_atom* a);
+// Record one Max atom as its JSON equivalent.
+static void snapshot_atom(t_atom* a, mx::dict_snapshot& out);
 
-// Walk a t_dictionary and build the equivalent JSON object. Max's
-// dictobj_dictionarytoatoms produces Max dictionary *text*, which is not JSON,
-// so building it explicitly is what makes the application/json mime type
-// truthful rather than merely plausible.
-static nl::json dictionary_to_json(t_dictionary* d) {
-    nl::json obj = nl::json::object();
-    if (!d) return obj;
+static void snapshot_atoms(long ac, t_atom* av, mx::dict_snapshot& out) {
+    out.begin_array();
+    for (long j = 0; j < ac; j++) {
+        snapshot_atom(av + j, out);
+    }
+    out.end_array();
+}
+
+// Walk a t_dictionary and record the equivalent JSON object, to be encoded
+// on the server thread. Max's dictobj_dictionarytoatoms produces Max
+// dictionary *text*, which is not JSON, so walking it explicitly is what makes
+// the application/json mime type truthful rather than merely plausible. Keys
+// keep the dictionary's order.
+static void snapshot_dictionary(t_dictionary* d, mx::dict_snapshot& out) {
+    out.begin_object();
 
     long numkeys = 0;
     t_symbol** keys = nullptr;
-    if (dictionary_getkeys(d, &numkeys, &keys) != MAX_ERR_NONE || !keys) {
-        return obj;
+    if (!d || dictionary_getkeys(d, &numkeys, &keys) != MAX_ERR_NONE || !keys) {
+        out.end_object();
+        return;
     }
 
     for (long i = 0; i < numkeys; i++) {
         t_symbol* key = keys[i];
-        const char* name = key->s_name;
 
         if (dictionary_entryisdictionary(d, key)) {
             t_object* sub = nullptr;
             if (dictionary_getobject(d, key, &sub) == MAX_ERR_NONE && sub) {
-                obj[name] = dictionary_to_json((t_dictionary*)sub);
+                out.key(key->s_name);
+                snapshot_dictionary((t_dictionary*)sub, out);
             }
             continue;
         }
@@ -726,56 +1129,57 @@ static nl::json dictionary_to_json(t_dictionary* d) {
                 long ac = 0;
                 t_atom* av = nullptr;
                 atomarray_getatoms((t_atomarray*)arr, &ac, &av);
-                nl::json items = nl::json::array();
-                for (long j = 0; j < ac; j++) {
-                    items.push_back(atom_to_json(av + j));
-                }
-                obj[name] = std::move(items);
+                out.key(key->s_name);
+                snapshot_atoms(ac, av, out);
             }
             continue;
         }
 
         t_atom value;
         if (dictionary_getatom(d, key, &value) == MAX_ERR_NONE) {
-            obj[name] = atom_to_json(&value);
+            out.key(key->s_name);
+            snapshot_atom(&value, out);
         }
     }
 
     dictionary_freekeys(d, numkeys, keys);
-    return obj;
+    out.end_object();
 }
 
-static nl::json atom_to_json(t_atom* a) {
+static void snapshot_atom(t_atom* a, mx::dict_snapshot& out) {
     switch (atom_gettype(a)) {
     case A_LONG:
-        return nl::json(static_cast<long long>(atom_getlong(a)));
+        out.value(static_cast<long long>(atom_getlong(a)));
+        return;
     case A_FLOAT:
-        return nl::json(atom_getfloat(a));
+        out.value(static_cast<double>(atom_getfloat(a)));
+        return;
     case A_SYM:
-        return nl::json(std::string(atom_getsym(a)->s_name));
+        out.value(atom_getsym(a)->s_name);
+        return;
     case A_OBJ: {
         t_object* o = (t_object*)atom_getobj(a);
         if (o && object_classname(o) == gensym("dictionary")) {
-            return dictionary_to_json((t_dictionary*)o);
+            snapshot_dictionary((t_dictionary*)o, out);
+            return;
         }
         if (o && object_classname(o) == gensym("atomarray")) {
             long ac = 0;
             t_atom* av = nullptr;
             atomarray_getatoms((t_atomarray*)o, &ac, &av);
-            nl::json items = nl::json::array();
-            for (long j = 0; j < ac; j++) {
-                items.push_back(atom_to_json(av + j));
-            }
-            return items;
+            snapshot_atoms(ac, av, out);
+            return;
         }
-        return nl::json(nullptr);
+        out.null();
+        return;
     }
     default:
-        return nl::json(nullptr);
+        out.null();
+        return;
     }
 }
 
-void kernel_dict(t_kernel* x, t_symbol* s) {
+static void post_dict(t_kernel* x, t_symbol* s, int cell) {
     auto* impl = x->impl;
     if (!impl) {
         object_error((t_object*)x, "not initialized");
@@ -788,23 +1192,69 @@ void kernel_dict(t_kernel* x, t_symbol* s) {
         return;
     }
 
+    // Only the copy happens here; the dictionary is released as soon as it is
+    // done, and the server thread encodes it as @encoding, which the mime
+    // type carries.
     mx::ResultMessage result;
     try {
-        result.text = dictionary_to_json(dict).dump(2);
-        result.mime_type = "application/json";
+        result.snapshot = std::make_unique<mx::dict_snapshot>();
+        snapshot_dictionary(dict, *result.snapshot);
+        result.mime_type = mx::mime_type(dict_encoding_of(x));
+        result.dict_name = s->s_name;
     } catch (const std::exception& e) {
         dictobj_release(dict);
-        object_error((t_object*)x, "failed to serialize dictionary '%s': %s",
+        object_error((t_object*)x, "failed to copy dictionary '%s': %s",
                      s->s_name, e.what());
         return;
     }
 
     dictobj_release(dict);
 
-    queue_for_jupyter(x, std::move(result));
+    const size_t records = result.snapshot->size();
+    queue_for_jupyter(x, std::move(result), cell);
 
     if (x->debug) {
-        object_post((t_object*)x, "dict '%s' queued as JSON", s->s_name);
+        object_post((t_object*)x, "dict '%s' queued (%zu records)", s->s_name,
+                    records);
+    }
+}
+
+void kernel_dict(t_kernel* x, t_symbol* s) {
+    post_dict(x, s, 0);
+}
+
+// ---------------------------------------------------------------------------
+// kernel_cell -- a reply naming the cell it answers, for @concurrency > 1
+// ---------------------------------------------------------------------------
+// "cell <n> result ...", "cell <n> print ..." and "cell <n> dict <name>" behave
+// exactly like the bare messages, except that they go to cell n rather than
+// to the oldest cell in flight. With several cells handed to Max at once, that
+// is the only way an answer can reach the right one.
+void kernel_cell(t_kernel* x, t_symbol* s, long argc, t_atom* argv) {
+    if (argc < 2 || atom_gettype(argv) != A_LONG || atom_gettype(argv + 1) != A_SYM) {
+        object_error((t_object*)x,
+                     "cell expects <counter> result|print|dict <args...>");
+        return;
+    }
+
+    const long counter = atom_getlong(argv);
+    if (counter <= 0) {
+        object_error((t_object*)x, "cell counter must be positive, got %ld", counter);
+        return;
+    }
+
+    const int cell = static_cast<int>(counter);
+    const std::string what = atom_getsym(argv + 1)->s_name;
+
+    if (what == "result") {
+        post_result(x, argc - 2, argv + 2, cell);
+    } else if (what == "print") {
+        post_print(x, argc - 2, argv + 2, cell);
+    } else if (what == "dict" && argc == 3 && atom_gettype(argv + 2) == A_SYM) {
+        post_dict(x, atom_getsym(argv + 2), cell);
+    } else {
+        object_error((t_object*)x, "cell %ld: cannot answer with '%s'",
+                     counter, what.c_str());
     }
 }
 
@@ -856,7 +1306,7 @@ void kernel_install(t_kernel* x) {
 
     if (x->outlet_right) {
         t_atom a;
-        atom_setsym(&a, gensym(filepath.c_str()));
+        atom_setsym(&a, intern_text(x, filepath));
         outlet_anything(x->outlet_right, gensym("installed"), 1, &a);
     }
 }
@@ -866,7 +1316,7 @@ void kernel_install(t_kernel* x) {
 // ---------------------------------------------------------------------------
 void kernel_assist(t_kernel* x, void* b, long m, long a, char* s) {
     if (m == ASSIST_INLET) {
-        snprintf(s, 256, "Messages: start, stop, info, eval, result, print, dict, install");
+        snprintf(s, 256, "Messages: start, stop, info, eval, result, print, dict, cell, install");
     } else {
         switch (a) {
         case 0:
@@ -1,4 +1,7 @@
 #include "interpreter.h"
+#include "atom_text.h"
+#include "dict_encoding.h"
+#include "json_writer.h"
 #include "types.h"
 #include "version.h"
 
@@ -13,25 +16,48 @@ namespace {
 // teardown can be delayed by a cell that is waiting for a result.
 constexpr std::chrono::milliseconds k_wait_slice{100};
 
-// Jupyter stream output is raw text: the client inserts no line breaks of its
-// own. One Max `print` message is one line, so terminate it here -- otherwise
-// consecutive messages run together, and the next Out[n] collides with the
-// last of them. Text that already ends in a newline is left alone.
-std::string as_line(const std::string& text) {
-    if (!text.empty() && text.back() == '\n') {
-        return text;
+// Stream name for free-standing output that does not name one.
+const std::string k_stdout = "stdout";
+
+// RFC 6902's media type, for `dict` results sent as changes.
+const std::string k_json_patch = "application/json-patch+json";
+
+// `dict` sends its dictionary as a snapshot, so it is encoded here on the
+// server thread rather than on Max's main thread: as JSON into r.text, or in
+// the binary encoding r.mime_type names into `binary`.
+void encode_snapshot(ResultMessage& r, std::vector<char>& binary) {
+    if (!r.snapshot) {
+        return;
+    }
+    switch (encoding_for_mime_type(r.mime_type)) {
+    case dict_encoding::json: {
+        json_writer out(r.text, 2);
+        r.snapshot->replay(out);
+        break;
+    }
+    case dict_encoding::cbor:
+        encode_cbor(*r.snapshot, binary);
+        break;
+    case dict_encoding::msgpack:
+        encode_msgpack(*r.snapshot, binary);
+        break;
     }
-    return text + "\n";
 }
 
-// Restores current_execution on every exit path from execute_request_impl.
-struct execution_scope {
-    t_kernel_impl* impl;
-    explicit execution_scope(t_kernel_impl* i, int counter) : impl(i) {
-        impl->current_execution.store(counter);
-    }
-    ~execution_scope() { impl->current_execution.store(0); }
-};
+// "application/cbor, 1234 bytes" -- the text/plain form of a binary result.
+std::string describe_binary(const std::string& mime, size_t bytes) {
+    return mime + ", " + std::to_string(bytes) + " bytes";
+}
+
+// How a client finds and reads the buffer of an array result.
+nl::json array_metadata(const typed_array& a) {
+    nl::json meta;
+    meta["dtype"] = dtype_name(a.dtype());
+    meta["shape"] = a.shape();
+    meta["byteorder"] = host_byte_order();
+    meta["buffer"] = 0;
+    return meta;
+}
 
 } // namespace
 
@@ -46,10 +72,173 @@ void max_interpreter::configure_impl() {
 }
 
 void max_interpreter::flush_async_output() {
-    while (auto out = m_impl->async_queue.try_pop()) {
-        const std::string name = out->stream_name.empty() ? std::string("stdout")
-                                                          : out->stream_name;
-        publish_stream(name, as_line(out->text));
+    // Attributed to the oldest cell in flight, if any; see on_idle.
+    const int owner = m_pending.empty() ? 0 : m_pending.front().counter;
+    m_impl->async_queue.drain_into(m_async_batch);
+    for (ResultMessage& out : m_async_batch) {
+        std::vector<char> binary;
+        encode_snapshot(out, binary);
+        // Stream output is text only; say what arrived.
+        if (out.array) {
+            out.text = describe(*out.array);
+        } else if (out.text.empty() && !binary.empty()) {
+            out.text = describe_binary(out.mime_type, binary.size());
+        }
+        const std::string& name = out.stream_name.empty() ? k_stdout : out.stream_name;
+        queue_stream(owner, name, out.text);
+    }
+    m_async_batch.clear();
+}
+
+void max_interpreter::encode_dict(ResultMessage& r, nl::json& metadata,
+                                  std::vector<char>& binary) {
+    const long resync_every = m_impl->dict_diff.load();
+    if (!r.snapshot || r.dict_name.empty() || resync_every <= 0) {
+        encode_snapshot(r, binary);
+        return;
+    }
+
+    std::string patch;
+    const auto u = m_dicts.next(r.dict_name, *r.snapshot, resync_every, patch);
+    metadata["diff"] = {{"dict", r.dict_name}, {"sequence", u.sequence}, {"full", u.full}};
+    if (u.full) {
+        encode_snapshot(r, binary);
+    } else {
+        r.text = std::move(patch);
+        r.mime_type = k_json_patch;
+    }
+    m_dicts.keep(r.dict_name, std::move(r.snapshot));
+}
+
+void max_interpreter::queue_stream(int counter, const std::string& name,
+                                   const std::string& text) {
+    // Closing a window may flush the batch to report drops, so before
+    // deciding whether this line joins it.
+    roll_rate_window();
+
+    // Jupyter stream output is raw text: the client inserts no line breaks of
+    // its own. One Max `print` message is one line, so terminate it here --
+    // otherwise consecutive messages run together, and the next Out[n]
+    // collides with the last of them. Text already ending in a newline is
+    // left alone.
+    const bool terminated = !text.empty() && text.back() == '\n';
+    const size_t added = text.size() + (terminated ? 0 : 1);
+
+    const long cap = m_impl->stream_batch_bytes.load();
+    const bool joins = !m_stream.text.empty() && m_stream.counter == counter
+                    && m_stream.name == name
+                    && static_cast<long>(m_stream.text.size() + added) <= cap;
+
+    // A line joining the batch adds bytes but no IOPub message.
+    if (!admit_stream(text.size(), !joins)) {
+        return;
+    }
+
+    if (!m_stream.text.empty() && !joins) {
+        flush_stream();
+    }
+
+    if (m_stream.text.empty()) {
+        m_stream.counter = counter;
+        m_stream.name = name;
+        m_stream.context = get_request_context();
+    }
+
+    m_stream.text += text;
+    if (!terminated) {
+        m_stream.text += '\n';
+    }
+
+    if (cap <= 0) {
+        flush_stream();
+    }
+}
+
+void max_interpreter::flush_stream() {
+    if (m_stream.text.empty()) {
+        return;
+    }
+
+    // Publish under the context the batch was started in, whichever cell is
+    // active now. Swapping rather than copying keeps this cheap.
+    const bool had_active = m_has_active;
+    std::swap(m_active_context, m_stream.context);
+    m_has_active = true;
+    publish_stream(m_stream.name, m_stream.text);
+    std::swap(m_active_context, m_stream.context);
+    m_has_active = had_active;
+
+    m_stream.text.clear();
+}
+
+bool max_interpreter::admit_stream(size_t bytes, bool new_message) {
+    const long window_ms = std::max(1L, m_impl->iopub_rate_window_ms.load());
+    const long msg_rate = m_impl->iopub_msg_rate_limit.load();
+    const long data_rate = m_impl->iopub_data_rate_limit.load();
+
+    // Limits are rates, so scale them to the window. At least one message
+    // per window always gets through, however low the rate is set.
+    const auto allowance = [window_ms](long rate) {
+        return std::max(1L, static_cast<long>(static_cast<long long>(rate) * window_ms / 1000));
+    };
+
+    const long size = static_cast<long>(bytes);
+    const bool over =
+        (new_message && msg_rate > 0 && m_rate.messages + 1 > allowance(msg_rate))
+        || (data_rate > 0 && m_rate.bytes + size > allowance(data_rate));
+
+    if (over) {
+        ++m_rate.dropped_messages;
+        m_rate.dropped_bytes += size;
+        m_impl->suppressed_messages.fetch_add(1);
+        m_impl->suppressed_bytes.fetch_add(size);
+        return false;
+    }
+
+    if (new_message) {
+        ++m_rate.messages;
+    }
+    m_rate.bytes += size;
+    return true;
+}
+
+void max_interpreter::roll_rate_window() {
+    const auto now = std::chrono::steady_clock::now();
+    const auto window = std::chrono::milliseconds(
+        std::max(1L, m_impl->iopub_rate_window_ms.load()));
+
+    if (now - m_rate.start < window) {
+        return;
+    }
+
+    const long dropped_messages = m_rate.dropped_messages;
+    const long dropped_bytes = m_rate.dropped_bytes;
+    m_rate = rate_window{};
+    m_rate.start = now;
+
+    // Messages Max could not queue at all, because the server thread had
+    // fallen a whole queue behind.
+    const size_t queue_drops = m_impl->result_queue.dropped() + m_impl->async_queue.dropped();
+    const size_t new_queue_drops = queue_drops - m_reported_queue_drops;
+    m_reported_queue_drops = queue_drops;
+
+    if (dropped_messages == 0 && new_queue_drops == 0) {
+        return;
+    }
+
+    // One line per window, however much was dropped, published directly so
+    // the summary is not itself subject to the limit it reports.
+    flush_stream();
+    if (dropped_messages != 0) {
+        publish_stream("stderr",
+                       "[kernel] " + std::to_string(dropped_messages) + " messages / "
+                       + std::to_string(dropped_bytes)
+                       + " bytes of output suppressed (IOPub rate limit)\n");
+    }
+    if (new_queue_drops != 0) {
+        publish_stream("stderr",
+                       "[kernel] " + std::to_string(new_queue_drops)
+                       + " messages from Max dropped (queue full)\n");
     }
 }
 
@@ -79,7 +268,7 @@ void max_interpreter::execute_request_impl(send_reply_callback cb,
     p.timeout_s = m_impl->timeout.load();
 
     m_pending.push_back(std::move(p));
-    m_impl->pending_executions.store(static_cast<int>(m_pending.size()));
+    update_shared_state();
 
     // Hand it to Max straight away rather than waiting for the next idle tick.
     pump();
@@ -88,37 +277,98 @@ void max_interpreter::execute_request_impl(send_reply_callback cb,
     // execution_input for this cell.
 }
 
-void max_interpreter::start_front() {
-    pending_execution& p = m_pending.front();
-
-    // Drop replies left over from an earlier cell before this one can see
-    // them, then declare this cell the one results belong to.
-    m_impl->result_queue.clear();
-    m_impl->current_execution.store(p.counter);
+bool max_interpreter::start(pending_execution& p) {
+    // With nothing else in flight, anything still queued is a leftover from
+    // an earlier cell; drop it before this one can see it. With other cells
+    // in flight the queue may hold their answers, and routing by counter
+    // discards leftovers instead.
+    if (m_in_flight == 0) {
+        m_impl->result_queue.clear();
+    }
 
-    OutletMessage msg;
-    msg.selector = "code";
-    msg.atoms.push_back(std::string("execute"));
-    msg.atoms.push_back(p.code);
+    OutletMessage msg = m_impl->make_outlet_message();
+    msg.selector = outlet_selector::code;
+    if (m_impl->concurrency.load() > 1) {
+        // Several cells may be with Max at once, so each carries its counter
+        // for the patch to answer with: `cell <n> result ...`.
+        msg.add_symbol("cell");
+        msg.add_long(p.counter);
+    } else {
+        msg.add_symbol("execute");
+    }
+    if (m_impl->tokenize.load()) {
+        // Parsed here, on the server thread, so Max's main thread only copies
+        // finished atoms -- and numbers never become symbols.
+        tokenize_into(p.code, msg);
+    } else {
+        msg.body_index = static_cast<int>(msg.size());
+        msg.add_symbol(p.code);
+    }
     msg.outlet_index = 0; // left outlet
     msg.execution_counter = p.counter;
 
-    m_impl->outlet_queue.push(std::move(msg));
-    m_impl->notify_main_thread();
-
     p.deadline = std::chrono::steady_clock::now()
                + std::chrono::seconds(p.timeout_s > 0 ? p.timeout_s : 0);
     p.started = true;
+    ++m_in_flight;
+    update_shared_state();
+
+    // The shared state goes first, so a reply that arrives the moment Max
+    // sees the code is stamped for this cell. A full ring means Max has
+    // stopped draining it: undo that, leave the cell queued and try again
+    // next tick.
+    const bool queued = m_impl->outlet_queue.push(std::move(msg));
+    if (!queued) {
+        p.started = false;
+        --m_in_flight;
+        update_shared_state();
+    }
+    m_impl->notify_main_thread();
+    return queued;
 }
 
-void max_interpreter::complete_front(nl::json reply) {
-    send_reply_callback cb = std::move(m_pending.front().cb);
-    m_pending.pop_front();
-    m_impl->current_execution.store(0);
-    m_impl->pending_executions.store(static_cast<int>(m_pending.size()));
+void max_interpreter::start_ready() {
+    const long limit = std::max(1L, m_impl->concurrency.load());
+    for (auto& p : m_pending) {
+        if (m_in_flight >= limit) {
+            break;
+        }
+        if (!p.started && !start(p)) {
+            break;
+        }
+    }
+}
+
+void max_interpreter::complete(pending_iterator it, nl::json reply) {
+    // The reply callback publishes the cell's idle status; its output must
+    // reach the client first.
+    flush_stream();
+    send_reply_callback cb = std::move(it->cb);
+    m_pending.erase(it);
+    --m_in_flight;
+    update_shared_state();
     cb(std::move(reply));
 }
 
+auto max_interpreter::find_started(int counter) -> pending_iterator {
+    return std::find_if(m_pending.begin(), m_pending.begin() + m_in_flight,
+                        [counter](const pending_execution& p) {
+                            return p.counter == counter;
+                        });
+}
+
+void max_interpreter::activate(const pending_execution& p) {
+    m_active_context = p.context;
+    m_has_active = true;
+}
+
+void max_interpreter::update_shared_state() {
+    // An unstamped reply from Max answers the oldest cell still waiting, which
+    // with one cell in flight is simply the cell that is running.
+    m_impl->current_execution.store(m_in_flight > 0 ? m_pending.front().counter : 0);
+    m_impl->pending_executions.store(static_cast<int>(m_pending.size()));
+}
+
 namespace {
 
 nl::json ok_reply(int counter) {
@@ -141,101 +391,145 @@ nl::json error_reply(const std::string& ename, const std::string& evalue) {
 
 } // namespace
 
-bool max_interpreter::service_front() {
-    pending_execution& p = m_pending.front();
-
-    if (!p.started) {
-        start_front();
-    }
-
-    // Fire and forget: the cell is done as soon as Max has the code.
-    if (p.timeout_s <= 0) {
-        const int counter = p.counter;
-        complete_front(ok_reply(counter));
-        return true;
+bool max_interpreter::settle() {
+    const auto in_flight_end = [this] { return m_pending.begin() + m_in_flight; };
+    bool completed = false;
+
+    // Fire and forget: a cell is done as soon as Max has the code.
+    for (auto it = m_pending.begin(); it != in_flight_end();) {
+        if (it->timeout_s <= 0) {
+            const int counter = it->counter;
+            activate(*it);
+            complete(it, ok_reply(counter));
+            it = m_pending.begin();
+            completed = true;
+        } else {
+            ++it;
+        }
     }
 
     // Teardown or a client shutdown: answer rather than leave the client
     // waiting on a reply that will never come.
     if (!m_impl->alive.load() || m_impl->shutdown_requested.load()) {
         const std::string evalue = "kernel is shutting down";
-        if (!p.silent) {
-            publish_execution_error("MaxShutdown", evalue, {});
+        while (m_in_flight > 0) {
+            auto it = m_pending.begin();
+            activate(*it);
+            flush_stream();
+            if (!it->silent) {
+                publish_execution_error("MaxShutdown", evalue, {});
+            }
+            complete(it, error_reply("MaxShutdown", evalue));
+            completed = true;
         }
-        complete_front(error_reply("MaxShutdown", evalue));
-        return true;
+        return completed;
     }
 
-    while (auto result = m_impl->result_queue.try_pop()) {
-        const ResultMessage& r = result.value();
+    // Take everything Max has sent so far in one go. Anything left over once
+    // the last cell completes is stale by definition and goes with the batch,
+    // as it would have gone when the next cell cleared the queue.
+    if (m_in_flight > 0) {
+        m_impl->result_queue.drain_into(m_result_batch);
+    }
+    for (ResultMessage& r : m_result_batch) {
+        // A reply stamped for a cell that is not in flight is stale; drop it.
+        auto it = find_started(r.execution_counter);
+        if (it == in_flight_end()) {
+            continue;
+        }
 
-        // A reply stamped for a different cell is stale; drop it.
-        if (r.execution_counter != p.counter) {
+        // Publish under the context of the cell the reply belongs to, so its
+        // output is attributed to it and not to whichever request arrived last.
+        activate(*it);
+
+        // Intermediate output: batch it and keep waiting for the result.
+        if (r.is_stream()) {
+            queue_stream(it->counter, r.stream_name, r.text);
             continue;
         }
 
+        flush_stream();
+
         if (r.is_error()) {
             publish_execution_error(r.error_name, r.error_value, {});
-            nl::json reply = error_reply(r.error_name, r.error_value);
-            complete_front(std::move(reply));
-            return true;
-        }
-
-        // Intermediate output: publish it and keep waiting for the result.
-        if (r.is_stream()) {
-            publish_stream(r.stream_name, as_line(r.text));
+            complete(it, error_reply(r.error_name, r.error_value));
+            completed = true;
             continue;
         }
 
+        std::vector<char> binary;
         nl::json data;
-        if (!r.mime_type.empty()) {
+        nl::json metadata = nl::json::object();
+        encode_dict(r, metadata, binary);
+        xeus::buffer_sequence buffers;
+        if (r.array) {
+            // The numbers travel as one binary frame; the JSON only
+            // describes them. Metadata first: taking the bytes empties it.
+            data["text/plain"] = describe(*r.array);
+            metadata["array"] = array_metadata(*r.array);
+            buffers.push_back(r.array->take_bytes());
+        } else if (!binary.empty()) {
+            // Likewise a CBOR or MessagePack dictionary. A mime bundle can
+            // only hold JSON, so the mime type goes in the metadata.
+            data["text/plain"] = describe_binary(r.mime_type, binary.size());
+            metadata["encoded"] = {{"mime_type", r.mime_type}, {"buffer", 0}};
+            buffers.push_back(std::move(binary));
+        } else if (!r.mime_type.empty()) {
             data[r.mime_type] = r.text;
         } else {
             data["text/plain"] = r.text;
         }
-        publish_execution_result(p.counter, std::move(data), nl::json::object());
-        const int counter = p.counter;
-        complete_front(ok_reply(counter));
-        return true;
-    }
-
-    if (std::chrono::steady_clock::now() < p.deadline) {
-        return false; // still waiting
+        const int counter = it->counter;
+        publish_execution_result(counter, std::move(data), std::move(metadata),
+                                 std::move(buffers));
+        complete(it, ok_reply(counter));
+        completed = true;
     }
+    m_result_batch.clear();
 
     // No result within the deadline. A timeout is not a success -- report it
     // as an error so programmatic clients can tell the difference.
-    const std::string ename = "MaxTimeout";
-    const std::string evalue =
-        "no result from Max within " + std::to_string(p.timeout_s) + "s: " + p.code;
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = m_pending.begin(); it != in_flight_end();) {
+        if (now < it->deadline) {
+            ++it;
+            continue;
+        }
 
-    if (!p.silent) {
-        publish_execution_error(ename, evalue, {});
+        const std::string ename = "MaxTimeout";
+        const std::string evalue = "no result from Max within "
+                                 + std::to_string(it->timeout_s) + "s: " + it->code;
+        activate(*it);
+        flush_stream();
+        if (!it->silent) {
+            publish_execution_error(ename, evalue, {});
+        }
+        complete(it, error_reply(ename, evalue));
+        it = m_pending.begin();
+        completed = true;
     }
-    complete_front(error_reply(ename, evalue));
-    return true;
+
+    return completed;
 }
 
 void max_interpreter::pump() {
-    while (!m_pending.empty()) {
-        // Publish under the context of the cell being serviced, so its output
-        // is attributed to it and not to whichever request arrived last.
-        m_active_context = m_pending.front().context;
-        m_has_active = true;
-        const bool completed = service_front();
-        m_has_active = false;
-
-        if (!completed) {
-            break;
-        }
-    }
+    // Completing a cell frees a slot, so keep going until nothing moves.
+    do {
+        start_ready();
+    } while (settle());
+
+    // End of the tick: whatever stream output is batched goes out now.
+    flush_stream();
+    m_has_active = false;
 }
 
 void max_interpreter::on_idle() {
+    // Report drops from a window that has ended, even once the flood stops.
+    roll_rate_window();
+
     if (!m_pending.empty()) {
-        // Attribute free-standing output to the cell that is running.
-        m_active_context = m_pending.front().context;
-        m_has_active = true;
+        // Attribute free-standing output to the oldest cell in flight.
+        activate(m_pending.front());
         flush_async_output();
         m_has_active = false;
     } else {
@@ -312,10 +606,12 @@ void max_interpreter::shutdown_request_impl() {
     }
 
     // Let the patch know a client asked to shut down.
-    OutletMessage msg;
-    msg.selector = "shutdown";
+    OutletMessage msg = m_impl->make_outlet_message();
+    msg.selector = outlet_selector::shutdown;
     msg.outlet_index = 1; // right outlet (status)
-    m_impl->outlet_queue.push(std::move(msg));
+    // Best effort: if Max is not draining the ring it will not see this
+    // either, and the shutdown goes ahead regardless.
+    (void)m_impl->outlet_queue.push(std::move(msg));
     m_impl->notify_main_thread();
 }
 
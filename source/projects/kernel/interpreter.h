@@ -2,11 +2,13 @@
 
 #include "xeus/xinterpreter.hpp"
 #include "xeus/xrequest_context.hpp"
+#include "dict_diff.h"
 #include "message_queue.h"
 
 #include <chrono>
 #include <deque>
 #include <string>
+#include <vector>
 
 namespace nl = nlohmann;
 
@@ -81,17 +83,85 @@ private:
         bool started = false;
     };
 
+    using pending_iterator = std::deque<pending_execution>::iterator;
+
     // Advance the queue as far as it can go without blocking.
     void pump();
-    // Returns true if the front cell completed and was removed.
-    bool service_front();
-    void start_front();
-    void complete_front(nl::json reply);
+    // Hand queued cells to Max until the concurrency limit is reached.
+    void start_ready();
+    // False, with the cell left unstarted, if outlet_queue is full.
+    bool start(pending_execution& p);
+    // Complete every in-flight cell that can be completed now. Returns true
+    // if any was, since that may free a slot for the next cell.
+    bool settle();
+    void complete(pending_iterator it, nl::json reply);
+    // The in-flight cell a result stamped with `counter` belongs to, or end().
+    pending_iterator find_started(int counter);
+    // Publish from here on under `p`'s request context.
+    void activate(const pending_execution& p);
+    // Keep current_execution and pending_executions in step with m_pending.
+    void update_shared_state();
 
     // Publish anything Max queued outside of a cell as stream output.
     void flush_async_output();
 
+    // Encode a `dict` result for its cell. With @diff, a dictionary published
+    // before goes out as a JSON Patch against its previous snapshot, recorded
+    // in `metadata`, and the new snapshot is kept for the next one.
+    void encode_dict(ResultMessage& r, nl::json& metadata, std::vector<char>& binary);
+
+    // Stream output not yet published. Consecutive lines for the same cell
+    // and stream are joined and go out as one IOPub message per tick, rather
+    // than a header, four JSON frames and a signature per line.
+    struct stream_batch {
+        int counter = 0; // cell the output belongs to; 0 outside any cell
+        std::string name;
+        std::string text;
+        xeus::xrequest_context context;
+    };
+
+    // Add one line to the batch, publishing the batch first if it belongs to
+    // another cell or stream, or would grow past the byte cap.
+    void queue_stream(int counter, const std::string& name, const std::string& text);
+    // Publish the batch, if any. Called before anything else is published,
+    // so batching never reorders stream output against results and errors.
+    void flush_stream();
+
+    // Stream output counted against the IOPub rate limits in the current
+    // window, and what the limits have dropped from it.
+    struct rate_window {
+        std::chrono::steady_clock::time_point start;
+        long messages = 0;
+        long bytes = 0;
+        long dropped_messages = 0;
+        long dropped_bytes = 0;
+    };
+
+    // Whether a line of `bytes` fits within the rate limits, counting it
+    // against the message limit only if it starts a new IOPub message rather
+    // than joining the batch. Counts it as published or dropped accordingly.
+    bool admit_stream(size_t bytes, bool new_message);
+    // Close the window once it has run its course, reporting anything it
+    // dropped as a single stderr line.
+    void roll_rate_window();
+
+    // Queued and in-flight cells, oldest first. Cells are started in order
+    // but may complete in any order, so the started ones are always a prefix.
     std::deque<pending_execution> m_pending;
+    int m_in_flight = 0;
+
+    stream_batch m_stream;
+    rate_window m_rate;
+    // result_queue and async_queue drops already reported on stderr.
+    size_t m_reported_queue_drops = 0;
+
+    // Scratch space for draining result_queue and async_queue a whole
+    // backlog at a time. Kept between ticks so draining does not allocate.
+    std::vector<ResultMessage> m_result_batch;
+    std::vector<ResultMessage> m_async_batch;
+
+    // The last snapshot published under each dictionary name, with @diff.
+    dict_history m_dicts;
 
     // Context of the request xeus is currently dispatching.
     xeus::xrequest_context m_dispatch_context;
@@ -0,0 +1,184 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+#include "atom_text.h"
+
+namespace mx {
+
+size_t utf8_sequence(const unsigned char* p, const unsigned char* end) {
+    const unsigned char c = p[0];
+    size_t length = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+
+    if (c < 0x80) {
+        return 1;
+    } else if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        if (c == 0xE0) low = 0xA0;
+        if (c == 0xED) high = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        if (c == 0xF0) low = 0x90;
+        if (c == 0xF4) high = 0x8F;
+    } else {
+        return 0;
+    }
+
+    if (static_cast<size_t>(end - p) < length) {
+        return 0;
+    }
+    if (p[1] < low || p[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; ++i) {
+        if (p[i] < 0x80 || p[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+json_writer::json_writer(std::string& out, int indent) : m_out(out), m_indent(indent) {}
+
+void json_writer::newline(size_t depth) {
+    m_out.push_back('\n');
+    m_out.append(depth * static_cast<size_t>(m_indent), ' ');
+}
+
+void json_writer::before_value() {
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (m_counts.empty()) {
+        return;
+    }
+    if (m_counts.back()++ > 0) {
+        m_out.push_back(',');
+    }
+    if (m_indent >= 0) {
+        newline(m_counts.size());
+    }
+}
+
+void json_writer::open(char bracket) {
+    before_value();
+    m_out.push_back(bracket);
+    m_counts.push_back(0);
+}
+
+void json_writer::close(char bracket) {
+    const bool had_values = m_counts.back() > 0;
+    m_counts.pop_back();
+    if (had_values && m_indent >= 0) {
+        newline(m_counts.size());
+    }
+    m_out.push_back(bracket);
+}
+
+void json_writer::begin_object() { open('{'); }
+void json_writer::end_object() { close('}'); }
+void json_writer::begin_array() { open('['); }
+void json_writer::end_array() { close(']'); }
+
+void json_writer::key(std::string_view name) {
+    before_value();
+    append_string(name);
+    m_out.push_back(':');
+    if (m_indent >= 0) {
+        m_out.push_back(' ');
+    }
+    m_after_key = true;
+}
+
+void json_writer::value(std::string_view text) {
+    before_value();
+    append_string(text);
+}
+
+void json_writer::value(long long number) {
+    before_value();
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    m_out.append(buffer, result.ptr);
+}
+
+void json_writer::value(double number) {
+    before_value();
+    if (!std::isfinite(number)) {
+        m_out.append("null");
+        return;
+    }
+    const size_t start = m_out.size();
+    append_shortest(m_out, number);
+    if (m_out.find_first_of(".eE", start) == std::string::npos) {
+        m_out.append(".0");
+    }
+}
+
+void json_writer::value(bool flag) {
+    before_value();
+    m_out.append(flag ? "true" : "false");
+}
+
+void json_writer::null() {
+    before_value();
+    m_out.append("null");
+}
+
+void json_writer::append_string(std::string_view text) {
+    static const char k_hex[] = "0123456789abcdef";
+
+    m_out.push_back('"');
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+    const auto* const end = p + text.size();
+
+    while (p != end) {
+        // Copy a run that needs no escaping in one go.
+        const auto* run = p;
+        while (p != end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\') {
+            ++p;
+        }
+        m_out.append(reinterpret_cast<const char*>(run), static_cast<size_t>(p - run));
+        if (p == end) {
+            break;
+        }
+
+        const unsigned char c = *p;
+        if (c >= 0x80) {
+            const size_t length = utf8_sequence(p, end);
+            if (length == 0) {
+                m_out.append("\xEF\xBF\xBD"); // U+FFFD
+                ++p;
+            } else {
+                m_out.append(reinterpret_cast<const char*>(p), length);
+                p += length;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':  m_out.append("\\\""); break;
+        case '\\': m_out.append("\\\\"); break;
+        case '\b': m_out.append("\\b"); break;
+        case '\f': m_out.append("\\f"); break;
+        case '\n': m_out.append("\\n"); break;
+        case '\r': m_out.append("\\r"); break;
+        case '\t': m_out.append("\\t"); break;
+        default:
+            m_out.append("\\u00");
+            m_out.push_back(k_hex[c >> 4]);
+            m_out.push_back(k_hex[c & 0xF]);
+            break;
+        }
+        ++p;
+    }
+    m_out.push_back('"');
+}
+
+} // namespace mx
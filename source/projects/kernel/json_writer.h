@@ -0,0 +1,72 @@
+#pragma once
+
+// json_writer -- JSON text written as it is walked, with no document in
+// between.
+//
+// `dict` used to build an nl::json tree from the Max dictionary -- a std::map
+// insert per key, a heap node per value -- and then dump it to a string. The
+// walk now calls begin_object/key/value/end_object on this instead, and the
+// text is produced in the same pass. Keys come out in the order they are
+// written, not sorted.
+//
+// Output is compact, or pretty-printed with `indent` spaces per level in the
+// layout nl::json::dump(indent) uses. Doubles are written by append_shortest,
+// as text that reads back as the same value, with ".0" added to an integral
+// one so it stays a float; NaN and infinities, which JSON cannot express, are
+// null. Strings are escaped as JSON requires, and invalid UTF-8 is replaced
+// with U+FFFD so the result is always valid.
+//
+// The caller is trusted to nest calls correctly -- a key before each value in
+// an object, ends matching begins. Max-free.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mx {
+
+// Length of the valid UTF-8 sequence starting at p, or 0 if there is none.
+// Rejects overlong forms, surrogates and code points past U+10FFFF. Shared
+// with dict_encoding.
+size_t utf8_sequence(const unsigned char* p, const unsigned char* end);
+
+class json_writer {
+public:
+    // Appends to `out`. A negative indent means compact output.
+    explicit json_writer(std::string& out, int indent = -1);
+
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+
+    // Inside an object, before each value.
+    void key(std::string_view name);
+
+    void value(std::string_view text);
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(int number) { value(static_cast<long long>(number)); }
+    void value(long number) { value(static_cast<long long>(number)); }
+    void value(long long number);
+    void value(double number);
+    void value(bool flag);
+    void null();
+
+private:
+    // Separator, newline and indent due before the next value or key.
+    void before_value();
+    void open(char bracket);
+    void close(char bracket);
+    void newline(size_t depth);
+    void append_string(std::string_view text);
+
+    std::string& m_out;
+    int m_indent;
+    // Values written so far in each open container, innermost last.
+    std::vector<uint32_t> m_counts;
+    bool m_after_key = false;
+};
+
+} // namespace mx
@@ -1,26 +1,21 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
-#include <variant>
 #include <vector>
 
-namespace mx {
-
-// A single typed atom value for outlet messages (mirrors Max atom types).
-using AtomValue = std::variant<std::string, long, double>;
+#include "dict_snapshot.h"
+#include "outlet_message.h"
+#include "typed_array.h"
 
-// Message destined for a Max outlet (produced by kernel thread, consumed on main thread).
-struct OutletMessage {
-    std::string selector;
-    std::vector<AtomValue> atoms;
-    int outlet_index = 0; // 0 = left, 1 = right
-    int execution_counter = 0;
-};
+namespace mx {
 
 // Result flowing back from Max to the kernel thread.
 //
@@ -34,6 +29,13 @@ struct ResultMessage {
     std::string error_value;
     std::string stream_name; // "stdout" / "stderr", empty => execution_result
     std::string mime_type;   // e.g. "application/json", empty => text/plain
+    // Set by `dict`: the dictionary as walked, still to be encoded as JSON
+    // into `text`. The server thread does that before it reads `text`.
+    std::unique_ptr<dict_snapshot> snapshot;
+    std::string dict_name;   // the dictionary `snapshot` was taken from
+    // Set by `result array`: numbers to publish as a binary buffer, with
+    // `text` unused.
+    std::unique_ptr<typed_array> array;
     int execution_counter = 0;
 
     bool is_error() const { return !error_name.empty(); }
@@ -44,15 +46,26 @@ struct ResultMessage {
 
 // Minimal thread-safe FIFO queue. Mutex + deque + condition variable, so a
 // consumer can block until an item arrives instead of polling.
+//
+// Optionally bounded: with a capacity, a push into a full queue is rejected,
+// returns false and is counted in dropped(), as SpscRing does. 0 means
+// unbounded.
 template <typename T>
 class ThreadSafeQueue {
 public:
-    void push(T item) {
+    explicit ThreadSafeQueue(size_t capacity = 0) : m_capacity(capacity) {}
+
+    bool push(T item) {
         {
             std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_capacity != 0 && m_queue.size() >= m_capacity) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
             m_queue.push_back(std::move(item));
         }
         m_cv.notify_one();
+        return true;
     }
 
     std::optional<T> try_pop() {
@@ -80,6 +93,19 @@ public:
         return item;
     }
 
+    // Move everything queued onto the end of `out`, under one lock, and
+    // return how many items that was. A consumer that reuses `out` drains a
+    // burst for one lock acquisition and no allocation.
+    size_t drain_into(std::vector<T>& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const size_t n = m_queue.size();
+        for (auto& item : m_queue) {
+            out.push_back(std::move(item));
+        }
+        m_queue.clear();
+        return n;
+    }
+
     bool empty() const {
         std::lock_guard<std::mutex> lock(m_mutex);
         return m_queue.empty();
@@ -95,10 +121,138 @@ public:
         m_queue.clear();
     }
 
+    size_t capacity() const { return m_capacity; }
+
+    // Pushes rejected because the queue was full, since construction.
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
 private:
     mutable std::mutex m_mutex;
     std::condition_variable m_cv;
     std::deque<T> m_queue;
+    const size_t m_capacity;
+    std::atomic<size_t> m_dropped{0};
+};
+
+// Bounded, lock-free queue for exactly one producer thread and one consumer
+// thread.
+//
+// Neither side takes a lock or allocates: items are moved into a fixed ring of
+// slots allocated up front. The two indices live on separate cache lines, each
+// next to the side's cached copy of the other index, so the producer and the
+// consumer only share a line when one of them finds the ring full or empty.
+//
+// Overflow policy: a push into a full ring is rejected. The item is left with
+// the caller, push returns false and dropped() counts it. The ring never
+// blocks the producer and never discards what the consumer has yet to see, so
+// what to do with an item that does not fit is the caller's decision.
+//
+// push may be called from different threads over time, and so may try_pop,
+// provided each hand-over happens-before the next call (a thread join, a
+// mutex) -- never from two threads at once.
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two, at least 2.
+    explicit SpscRing(size_t capacity)
+        : m_mask(round_up(capacity) - 1), m_slots(m_mask + 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side. False, and the item untouched, when the ring is full.
+    bool push(T&& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head_cache > m_mask) {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail - m_head_cache > m_mask) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(const T& item) {
+        T copy(item);
+        return push(std::move(copy));
+    }
+
+    // Consumer side.
+    std::optional<T> try_pop() {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail_cache) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tail_cache) {
+                return std::nullopt;
+            }
+        }
+        std::optional<T> item(std::move(m_slots[head & m_mask]));
+        m_head.store(head + 1, std::memory_order_release);
+        return item;
+    }
+
+    // Consumer side: move everything queued onto the end of `out` and return
+    // how many items that was. One look at the producer's index and one
+    // release of the slots, however many there are.
+    size_t drain_into(std::vector<T>& out) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        for (size_t i = head; i != tail; ++i) {
+            out.push_back(std::move(m_slots[i & m_mask]));
+        }
+        m_tail_cache = tail;
+        m_head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    // Consumer side: discard everything queued so far.
+    void clear() {
+        while (try_pop()) {
+        }
+    }
+
+    // Either side. Exact only while the other side is idle.
+    bool empty() const { return size() == 0; }
+
+    size_t size() const {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Pushes rejected because the ring was full, since construction.
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    // Not std::hardware_destructive_interference_size: libc++ does not
+    // provide it, and 64 bytes is right for both x86-64 and Apple silicon's
+    // L1 (its 128-byte L2 lines only pair adjacent lines).
+    static constexpr size_t k_cache_line = 64;
+
+    static size_t round_up(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const size_t m_mask;
+    std::vector<T> m_slots;
+
+    // Consumer's line: its index and its last look at the producer's.
+    alignas(k_cache_line) std::atomic<size_t> m_head{0};
+    size_t m_tail_cache = 0;
+
+    // Producer's line.
+    alignas(k_cache_line) std::atomic<size_t> m_tail{0};
+    size_t m_head_cache = 0;
+    std::atomic<size_t> m_dropped{0};
+    // The class is cache-line aligned, so its size is too: whatever follows
+    // it in memory starts on a line of its own.
 };
 
 } // namespace mx
@@ -0,0 +1,91 @@
+#pragma once
+
+// Budgeted delivery of outlet_queue to Max.
+//
+// The qelem callback runs on Max's main thread, which also runs the UI.
+// Draining a large backlog in one go -- many queued cells, a burst of
+// messages -- would freeze it for as long as the patch takes to process them
+// all. OutletDrain delivers at most a budget's worth per call and reports
+// whether anything is left, so the caller can re-arm the qelem and let Max
+// get on with everything else in between.
+//
+// Max-free: the queue, the sink that stands in for outlet_anything and the
+// clock are all supplied by the caller, so the policy is tested on its own.
+
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "message_queue.h"
+
+namespace mx {
+
+struct drain_budget {
+    // Messages delivered per call, at most.
+    size_t max_messages = 64;
+    // Time spent delivering per call, at most, measured after each message.
+    // A single slow message can overrun it; it cannot be interrupted.
+    std::chrono::microseconds max_time{2000};
+};
+
+// Main thread only.
+class OutletDrain {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit OutletDrain(drain_budget budget = {}) : m_budget(budget) {}
+
+    void set_budget(drain_budget budget) { m_budget = budget; }
+    const drain_budget& budget() const { return m_budget; }
+
+    // Deliver queued messages to sink, in order, until there are none left or
+    // the budget is spent. Returns true if messages remain, in which case the
+    // caller must arrange to be called again. At least one message is
+    // delivered per call, so a backlog always makes progress.
+    //
+    // Messages are taken from the queue a backlog at a time and held here
+    // until delivered, so the queue sees one drain per backlog, not per call.
+    // The sink gets each one as OutletMessage& and may move from it, which
+    // the external does to recycle it.
+    template <typename Queue, typename Sink, typename Now>
+    bool run(Queue& queue, Sink&& sink, Now&& now) {
+        const clock::time_point start = now();
+        size_t delivered = 0;
+
+        while (true) {
+            if (m_next == m_backlog.size()) {
+                m_backlog.clear();
+                m_next = 0;
+                if (queue.drain_into(m_backlog) == 0) {
+                    return false;
+                }
+            }
+
+            if (delivered > 0
+                && (delivered >= m_budget.max_messages
+                    || now() - start >= m_budget.max_time)) {
+                return true;
+            }
+
+            sink(m_backlog[m_next]);
+            ++m_next;
+            ++delivered;
+        }
+    }
+
+    template <typename Queue, typename Sink>
+    bool run(Queue& queue, Sink&& sink) {
+        return run(queue, std::forward<Sink>(sink), [] { return clock::now(); });
+    }
+
+    // Messages taken from the queue but not yet delivered.
+    size_t held() const { return m_backlog.size() - m_next; }
+
+private:
+    drain_budget m_budget;
+    std::vector<OutletMessage> m_backlog;
+    size_t m_next = 0;
+};
+
+} // namespace mx
@@ -0,0 +1,113 @@
+#pragma once
+
+// OutletMessage -- a message for one of the object's outlets, flattened for
+// the trip from the kernel thread to Max's main thread.
+//
+// As a selector string and a vector of variant atoms, every cell cost four
+// allocations before it left the kernel thread: the selector, "execute", the
+// copy of the code and the vector itself. Here the selector is an ID, the
+// atoms are a table of tagged entries, and the text of every symbol sits in
+// one byte buffer, each NUL-terminated so the main thread can pass it to
+// gensym where it lies.
+//
+// clear() keeps both allocations. t_kernel_impl hands delivered messages back
+// to the kernel thread for reuse (outlet_free), so once the buffers have grown
+// to fit, building, queueing and delivering a message allocates nothing.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace mx {
+
+// Every selector the kernel thread sends to Max.
+enum class outlet_selector : uint8_t {
+    code,     // left outlet: a cell to run
+    shutdown, // right outlet: a client asked to shut down
+};
+
+inline const char* selector_name(outlet_selector s) {
+    switch (s) {
+    case outlet_selector::code:     return "code";
+    case outlet_selector::shutdown: return "shutdown";
+    }
+    return "";
+}
+
+// The three Max atom types the kernel sends.
+enum class atom_tag : uint8_t { symbol, integer, real };
+
+class OutletMessage {
+public:
+    outlet_selector selector = outlet_selector::code;
+    int outlet_index = 0; // 0 = left, 1 = right
+    int execution_counter = 0;
+    // Index of the atom holding a cell's source, or -1. The external delivers
+    // that one according to @delivery rather than always as a symbol.
+    int body_index = -1;
+
+    // Empty the message for reuse, keeping its allocations.
+    void clear() {
+        selector = outlet_selector::code;
+        outlet_index = 0;
+        execution_counter = 0;
+        body_index = -1;
+        m_atoms.clear();
+        m_text.clear();
+    }
+
+    void add_symbol(std::string_view text) {
+        flat_atom a;
+        a.tag = atom_tag::symbol;
+        a.length = static_cast<uint32_t>(text.size());
+        a.offset = m_text.size();
+        m_text.insert(m_text.end(), text.begin(), text.end());
+        m_text.push_back('\0');
+        m_atoms.push_back(a);
+    }
+
+    void add_long(long value) {
+        flat_atom a;
+        a.tag = atom_tag::integer;
+        a.integer = value;
+        m_atoms.push_back(a);
+    }
+
+    void add_double(double value) {
+        flat_atom a;
+        a.tag = atom_tag::real;
+        a.real = value;
+        m_atoms.push_back(a);
+    }
+
+    size_t size() const { return m_atoms.size(); }
+    bool empty() const { return m_atoms.empty(); }
+
+    atom_tag tag(size_t i) const { return m_atoms[i].tag; }
+
+    // Only valid for an atom of the matching tag.
+    std::string_view symbol(size_t i) const {
+        return std::string_view(m_text.data() + m_atoms[i].offset, m_atoms[i].length);
+    }
+    const char* symbol_cstr(size_t i) const { return m_text.data() + m_atoms[i].offset; }
+    long integer(size_t i) const { return m_atoms[i].integer; }
+    double real(size_t i) const { return m_atoms[i].real; }
+
+private:
+    struct flat_atom {
+        atom_tag tag = atom_tag::integer;
+        uint32_t length = 0; // symbols: bytes, excluding the terminator
+        union {
+            size_t offset; // symbols: start in m_text
+            long integer;
+            double real;
+        };
+        flat_atom() : offset(0) {}
+    };
+
+    std::vector<flat_atom> m_atoms;
+    std::vector<char> m_text;
+};
+
+} // namespace mx
@@ -0,0 +1,97 @@
+#pragma once
+
+// Per-object cache of interned symbols for the outlet drain.
+//
+// gensym hashes its argument and looks it up in Max's global symbol table,
+// under Max's lock, on the main thread. The drain needs the same few symbols
+// over and over -- the selectors, "execute", "cell", and with @tokenize the
+// recurring words of the patch's own language -- so it asks here first.
+//
+// Selectors are looked up by ID, an array index. Other short text goes
+// through a small direct-mapped table: the slot is picked from the length
+// and three characters, and a hit costs one compare. Longer text, such as a
+// whole cell, is rarely repeated and always goes straight to the intern
+// function.
+//
+// Max-free: Symbol is t_symbol in the external and a fake in the tests, and
+// the intern function is gensym or a stand-in. Main thread only.
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include "outlet_message.h"
+
+namespace mx {
+
+template <typename Symbol>
+class symbol_cache {
+public:
+    using intern_fn = std::function<Symbol*(const char*)>;
+
+    // Text longer than this is never cached.
+    static constexpr size_t k_max_length = 23;
+    static constexpr size_t k_slots = 256;
+
+    explicit symbol_cache(intern_fn intern) : m_intern(std::move(intern)) {}
+
+    Symbol* selector(outlet_selector s) {
+        Symbol*& slot = m_selectors[static_cast<size_t>(s)];
+        if (!slot) {
+            slot = m_intern(selector_name(s));
+        }
+        return slot;
+    }
+
+    // `terminated` must be followed by a NUL, as OutletMessage symbols and
+    // string literals are, so that a miss can intern it without a copy.
+    Symbol* lookup(std::string_view terminated) {
+        if (terminated.size() > k_max_length) {
+            ++m_misses;
+            return m_intern(terminated.data());
+        }
+
+        entry& e = m_entries[slot_for(terminated)];
+        if (e.symbol && e.length == terminated.size()
+            && std::memcmp(e.text, terminated.data(), terminated.size()) == 0) {
+            ++m_hits;
+            return e.symbol;
+        }
+
+        ++m_misses;
+        e.symbol = m_intern(terminated.data());
+        e.length = static_cast<unsigned char>(terminated.size());
+        std::memcpy(e.text, terminated.data(), terminated.size());
+        return e.symbol;
+    }
+
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    struct entry {
+        Symbol* symbol = nullptr;
+        unsigned char length = 0;
+        char text[k_max_length];
+    };
+
+    static size_t slot_for(std::string_view text) {
+        const size_t n = text.size();
+        if (n == 0) {
+            return 0;
+        }
+        const auto c = [&text](size_t i) { return static_cast<unsigned char>(text[i]); };
+        return (n * 131 + c(0) * 31 + c(n / 2) * 7 + c(n - 1)) % k_slots;
+    }
+
+    intern_fn m_intern;
+    std::array<Symbol*, 2> m_selectors{};
+    std::array<entry, k_slots> m_entries{};
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
+
+} // namespace mx
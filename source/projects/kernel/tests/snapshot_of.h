@@ -0,0 +1,50 @@
+#pragma once
+
+// Snapshots built from nl::json documents, for the tests of what consumes a
+// dict_snapshot. Records the document as the dictionary walk would; objects
+// come out in nl::json's key order.
+
+#include "../dict_snapshot.h"
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace mx {
+namespace test {
+
+inline void record(const nlohmann::json& j, dict_snapshot& out) {
+    if (j.is_object()) {
+        out.begin_object();
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            out.key(it.key());
+            record(it.value(), out);
+        }
+        out.end_object();
+    } else if (j.is_array()) {
+        out.begin_array();
+        for (const auto& item : j) {
+            record(item, out);
+        }
+        out.end_array();
+    } else if (j.is_string()) {
+        out.value(j.get_ref<const std::string&>());
+    } else if (j.is_number_float()) {
+        out.value(j.get<double>());
+    } else if (j.is_number()) {
+        out.value(j.get<long long>());
+    } else if (j.is_boolean()) {
+        out.value(j.get<bool>());
+    } else {
+        out.null();
+    }
+}
+
+inline dict_snapshot snapshot_of(const nlohmann::json& j) {
+    dict_snapshot s;
+    record(j, s);
+    return s;
+}
+
+} // namespace test
+} // namespace mx
@@ -0,0 +1,202 @@
+#include "doctest.h"
+
+#include "../atom_text.h"
+
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+
+// An atom as a variant, so expectations read as values.
+using atom = std::variant<std::string, long, double>;
+
+std::vector<atom> atoms_of(const mx::OutletMessage& msg) {
+    std::vector<atom> out;
+    for (size_t i = 0; i < msg.size(); ++i) {
+        switch (msg.tag(i)) {
+        case mx::atom_tag::symbol:  out.emplace_back(std::string(msg.symbol(i))); break;
+        case mx::atom_tag::integer: out.emplace_back(msg.integer(i)); break;
+        case mx::atom_tag::real:    out.emplace_back(msg.real(i)); break;
+        }
+    }
+    return out;
+}
+
+std::vector<atom> tokenize(const std::string& text) {
+    mx::OutletMessage msg;
+    mx::tokenize_into(text, msg);
+    return atoms_of(msg);
+}
+
+std::string format(const std::vector<atom>& atoms) {
+    std::string out;
+    mx::format_atoms(out, atoms.data(), atoms.data() + atoms.size(),
+                     [](const atom& a, mx::atom_text_writer& writer) {
+        if (const auto* s = std::get_if<std::string>(&a)) {
+            writer.symbol(*s);
+        } else if (const auto* l = std::get_if<long>(&a)) {
+            writer.integer(*l);
+        } else {
+            writer.real(std::get<double>(a));
+        }
+    });
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("tokenize splits on any whitespace and drops empty tokens") {
+    auto atoms = tokenize("  metro\t100 \n\r start  ");
+    REQUIRE(atoms.size() == 3);
+    CHECK(std::get<std::string>(atoms[0]) == "metro");
+    CHECK(std::get<long>(atoms[1]) == 100);
+    CHECK(std::get<std::string>(atoms[2]) == "start");
+
+    CHECK(tokenize("").empty());
+    CHECK(tokenize(" \n\t ").empty());
+}
+
+TEST_CASE("tokenize types numbers the way a message box does") {
+    SUBCASE("integers") {
+        auto atoms = tokenize("0 42 -7");
+        CHECK(std::get<long>(atoms[0]) == 0);
+        CHECK(std::get<long>(atoms[1]) == 42);
+        CHECK(std::get<long>(atoms[2]) == -7);
+    }
+
+    SUBCASE("floats") {
+        auto atoms = tokenize("0.5 -2.25 .5 1e3 -1.5e-2 3.");
+        REQUIRE(atoms.size() == 6);
+        CHECK(std::get<double>(atoms[0]) == 0.5);
+        CHECK(std::get<double>(atoms[1]) == -2.25);
+        CHECK(std::get<double>(atoms[2]) == 0.5);
+        CHECK(std::get<double>(atoms[3]) == 1000.0);
+        CHECK(std::get<double>(atoms[4]) == -0.015);
+        CHECK(std::get<double>(atoms[5]) == 3.0);
+    }
+
+    SUBCASE("an integer too large for a long is a float") {
+        auto atoms = tokenize("123456789012345678901234567890");
+        CHECK(std::holds_alternative<double>(atoms[0]));
+    }
+
+    SUBCASE("anything only partly numeric is a symbol") {
+        for (const char* text : {"2*3", "1+", "-", ".", "1e", "1e+", "1e-", "1.2.3",
+                                 "0x10", "+5", "inf", "nan", "-inf", "1,", "3;"}) {
+            auto atoms = tokenize(text);
+            REQUIRE(atoms.size() == 1);
+            CHECK_MESSAGE(std::holds_alternative<std::string>(atoms[0]), text);
+        }
+    }
+}
+
+TEST_CASE("tokenize reads floats exactly without from_chars") {
+    // The short path and the stream fallback both run on every platform;
+    // these straddle the line between them.
+    for (const char* text : {"0.1", "-0.3", "1e22", "1e23", "9007199254740992.5",
+                             "9007199254740993.0", "0.1234567890123456789012345",
+                             "2.2250738585072014e-308", "4.9e-324", "1.7976931348623157e308",
+                             "1e-22", "1e-23", "0.000001"}) {
+        auto atoms = tokenize(text);
+        REQUIRE(atoms.size() == 1);
+        REQUIRE_MESSAGE(std::holds_alternative<double>(atoms[0]), text);
+        CHECK_MESSAGE(std::get<double>(atoms[0]) == std::strtod(text, nullptr), text);
+    }
+
+    SUBCASE("out of range is a symbol, not zero or infinity") {
+        for (const char* text : {"1e400", "-1e400", "1e-400"}) {
+            auto atoms = tokenize(text);
+            REQUIRE(atoms.size() == 1);
+            CHECK_MESSAGE(std::holds_alternative<std::string>(atoms[0]), text);
+        }
+    }
+}
+
+TEST_CASE("tokenize appends") {
+    mx::OutletMessage msg;
+    msg.add_symbol("execute");
+    mx::tokenize_into("1 + 2", msg);
+    const auto out = atoms_of(msg);
+    REQUIRE(out.size() == 4);
+    CHECK(std::get<std::string>(out[0]) == "execute");
+    CHECK(std::get<long>(out[1]) == 1);
+    CHECK(std::get<std::string>(out[2]) == "+");
+    CHECK(std::get<long>(out[3]) == 2);
+}
+
+TEST_CASE("format_atoms joins atoms with single spaces") {
+    CHECK(format({}) == "");
+    CHECK(format({std::string("metro")}) == "metro");
+    CHECK(format({std::string("metro"), 100L, std::string("start")}) == "metro 100 start");
+    CHECK(format({-7L, std::string("")}) == "-7 ");
+}
+
+TEST_CASE("format_atoms writes integers in full") {
+    CHECK(format({0L}) == "0");
+    CHECK(format({std::numeric_limits<long>::min()})
+          == std::to_string(std::numeric_limits<long>::min()));
+    CHECK(format({std::numeric_limits<long>::max()})
+          == std::to_string(std::numeric_limits<long>::max()));
+}
+
+TEST_CASE("format_atoms writes the shortest float that reads back the same") {
+    CHECK(format({0.1}) == "0.1");
+    CHECK(format({0.5}) == "0.5");
+    CHECK(format({-0.015}) == "-0.015");
+    CHECK(format({3.14159265}) == "3.14159265"); // a stream says 3.14159
+    CHECK(format({1.0 / 3.0}) == "0.3333333333333333");
+    CHECK(format({2.0}) == "2");
+
+    for (double value : {0.1, 1.0 / 3.0, 6.02214076e23, -1.5e-300, 123456.789,
+                         std::numeric_limits<double>::max(),
+                         std::numeric_limits<double>::denorm_min()}) {
+        const std::string text = format({value});
+        CHECK_MESSAGE(std::strtod(text.c_str(), nullptr) == value, text);
+    }
+}
+
+TEST_CASE("format_atoms writes the same text on every platform") {
+    // No std::to_chars here: libc++ lacks it for floats under the Max SDK's
+    // deployment target, so this is the formatter macOS runs too.
+    CHECK(format({1e22}) == "1e+22");
+    CHECK(format({-1e-7}) == "-1e-07");
+    CHECK(format({5e-324}) == "5e-324");
+    CHECK(format({100.0}) == "100");
+    CHECK(format({-0.0}) == "-0");
+    CHECK(format({std::numeric_limits<double>::infinity()}) == "inf");
+    CHECK(format({-std::numeric_limits<double>::infinity()}) == "-inf");
+    CHECK(format({std::numeric_limits<double>::quiet_NaN()}) == "nan");
+}
+
+TEST_CASE("format_atoms output tokenizes back to the same numbers") {
+    const std::vector<atom> atoms{std::string("line"), 0.25, 440L, -1.0e-5};
+    const auto back = tokenize(format(atoms));
+    REQUIRE(back.size() == 4);
+    CHECK(std::get<std::string>(back[0]) == "line");
+    CHECK(std::get<double>(back[1]) == 0.25);
+    CHECK(std::get<long>(back[2]) == 440);
+    CHECK(std::get<double>(back[3]) == -1.0e-5);
+}
+
+TEST_CASE("format_atoms skips what read leaves out and appends") {
+    struct fake_atom {
+        int type; // 0 = skip, 1 = long, 2 = double
+        double value;
+    };
+    const fake_atom atoms[] = {{1, 1}, {0, 0}, {2, 2.5}, {0, 0}};
+
+    std::string out = "result";
+    out += ' ';
+    mx::format_atoms(out, std::begin(atoms), std::end(atoms),
+                     [](const fake_atom& a, mx::atom_text_writer& writer) {
+        if (a.type == 1) {
+            writer.integer(static_cast<long>(a.value));
+        } else if (a.type == 2) {
+            writer.real(a.value);
+        }
+    });
+    CHECK(out == "result 1 2.5");
+}
@@ -0,0 +1,139 @@
+// Tests for @diff: the JSON Patch between two snapshots, checked by applying
+// it with nl::json, and the resync schedule of dict_history.
+
+#include "doctest.h"
+
+#include "../dict_diff.h"
+#include "../dict_snapshot.h"
+
+#include "snapshot_of.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+using mx::test::snapshot_of;
+
+nl::json patch_between(const nl::json& from, const nl::json& to) {
+    std::string text;
+    mx::write_patch(snapshot_of(from), snapshot_of(to), text);
+    return nl::json::parse(text);
+}
+
+const nl::json k_state = {
+    {"tempo", 120},
+    {"playing", true},
+    {"voices", {{{"note", 60}, {"gain", 0.5}}, {{"note", 64}, {"gain", 0.25}}}},
+    {"name", "pad"},
+};
+
+} // namespace
+
+TEST_CASE("dict_diff: an unchanged dictionary is an empty patch") {
+    std::string text;
+    mx::write_patch(snapshot_of(k_state), snapshot_of(k_state), text);
+    CHECK(text == "[]");
+}
+
+TEST_CASE("dict_diff: changed values become replace operations") {
+    nl::json next = k_state;
+    next["tempo"] = 121;
+    next["voices"][1]["gain"] = 0.75;
+    next["playing"] = nullptr;
+    next["name"] = "lead";
+
+    const nl::json patch = patch_between(k_state, next);
+    CHECK(patch.size() == 4);
+    for (const auto& op : patch) {
+        CHECK(op["op"] == "replace");
+    }
+    const nl::json gain = {{"op", "replace"}, {"path", "/voices/1/gain"}, {"value", 0.75}};
+    CHECK(std::find(patch.begin(), patch.end(), gain) != patch.end());
+    CHECK(k_state.patch(patch) == next);
+}
+
+TEST_CASE("dict_diff: an int becoming a float is a change") {
+    const nl::json from = {{"x", 1}};
+    const nl::json to = {{"x", 1.5}};
+    CHECK(from.patch(patch_between(from, to)) == to);
+}
+
+TEST_CASE("dict_diff: keys are escaped as JSON Pointers") {
+    const nl::json from = {{"a/b", 1}, {"m~n", 2}};
+    const nl::json to = {{"a/b", 3}, {"m~n", 4}};
+    const nl::json patch = patch_between(from, to);
+    CHECK(patch[0]["path"] == "/a~1b");
+    CHECK(patch[1]["path"] == "/m~0n");
+    CHECK(from.patch(patch) == to);
+}
+
+TEST_CASE("dict_diff: a change of shape falls back to a general diff") {
+    nl::json grown = k_state;
+    grown["voices"].push_back({{"note", 67}, {"gain", 0.1}});
+    grown["swing"] = 0.2;
+    CHECK(k_state.patch(patch_between(k_state, grown)) == grown);
+
+    nl::json shrunk = k_state;
+    shrunk.erase("name");
+    shrunk["voices"][0] = "muted";
+    CHECK(k_state.patch(patch_between(k_state, shrunk)) == shrunk);
+    CHECK(shrunk.patch(patch_between(shrunk, k_state)) == k_state);
+}
+
+TEST_CASE("dict_diff: invalid UTF-8 is replaced on either path") {
+    const std::string replacement = "\xEF\xBF\xBD";
+    const nl::json from = {{"name", "ok"}};
+
+    // Same shape: the changed value is written by json_writer.
+    std::string same;
+    CHECK_NOTHROW(
+        mx::write_patch(snapshot_of(from), snapshot_of({{"name", "\xff\xfe bad"}}), same));
+    CHECK(nl::json::parse(same)[0]["value"] == replacement + replacement + " bad");
+
+    // A new key: the general diff, which must not throw either.
+    std::string grown;
+    CHECK_NOTHROW(mx::write_patch(snapshot_of(from),
+                                  snapshot_of({{"name", "ok"}, {"bad", "\xff\xfe bad"}}), grown));
+    const nl::json patch = nl::json::parse(grown);
+    REQUIRE(patch.size() == 1);
+    CHECK(patch[0]["path"] == "/bad");
+    CHECK(patch[0]["value"] == replacement + replacement + " bad");
+}
+
+TEST_CASE("dict_history: the whole document first and every N updates") {
+    mx::dict_history history;
+    nl::json state = k_state;
+    for (long i = 0; i < 7; ++i) {
+        state["tempo"] = 100 + i;
+        auto snapshot = std::make_unique<mx::dict_snapshot>(snapshot_of(state));
+        std::string patch;
+        const auto u = history.next("state", *snapshot, 3, patch);
+        CHECK(u.sequence == i);
+        CHECK(u.full == (i % 3 == 0));
+        if (u.full) {
+            CHECK(patch.empty());
+        } else {
+            CHECK(nl::json::parse(patch)
+                  == nl::json::array({{{"op", "replace"}, {"path", "/tempo"}, {"value", 100 + i}}}));
+        }
+        history.keep("state", std::move(snapshot));
+    }
+    CHECK(history.size() == 1);
+}
+
+TEST_CASE("dict_history: dictionaries are tracked by name") {
+    mx::dict_history history;
+    const auto snapshot = snapshot_of(k_state);
+    std::string patch;
+    CHECK(history.next("a", snapshot, 10, patch).full);
+    history.keep("a", std::make_unique<mx::dict_snapshot>(snapshot));
+    CHECK(history.next("b", snapshot, 10, patch).full);
+    CHECK_FALSE(history.next("a", snapshot, 10, patch).full);
+    CHECK(patch == "[]");
+}
@@ -0,0 +1,179 @@
+// Tests for the CBOR and MessagePack encoders behind @encoding. nl::json's
+// own decoders are the reference: whatever the encoders write must read
+// back as the same document, and where the formats leave no choice, match
+// nl::json's encoders byte for byte.
+
+#include "doctest.h"
+
+#include "../dict_encoding.h"
+#include "../dict_snapshot.h"
+#include "../json_writer.h"
+
+#include "snapshot_of.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+using mx::test::snapshot_of;
+
+nl::json via_cbor(const nl::json& j) {
+    std::vector<char> bytes;
+    mx::encode_cbor(snapshot_of(j), bytes);
+    return nl::json::from_cbor(bytes);
+}
+
+nl::json via_msgpack(const nl::json& j) {
+    std::vector<char> bytes;
+    mx::encode_msgpack(snapshot_of(j), bytes);
+    return nl::json::from_msgpack(bytes);
+}
+
+std::vector<char> as_chars(const std::vector<std::uint8_t>& bytes) {
+    return std::vector<char>(bytes.begin(), bytes.end());
+}
+
+// Integers at every width boundary of both formats.
+nl::json boundary_integers() {
+    nl::json a = nl::json::array();
+    for (long long v : {0LL, 1LL, 23LL, 24LL, 31LL, 32LL, 127LL, 128LL, 255LL, 256LL,
+                        65535LL, 65536LL, 4294967295LL, 4294967296LL,
+                        std::numeric_limits<long long>::max(),
+                        -1LL, -24LL, -25LL, -32LL, -33LL, -128LL, -129LL, -256LL, -257LL,
+                        -32768LL, -32769LL, -65536LL, -65537LL,
+                        -2147483648LL, -2147483649LL,
+                        std::numeric_limits<long long>::min()}) {
+        a.push_back(v);
+    }
+    return a;
+}
+
+} // namespace
+
+TEST_CASE("dict_encoding: mime types name the encodings") {
+    CHECK(std::string(mx::mime_type(mx::dict_encoding::json)) == "application/json");
+    CHECK(std::string(mx::mime_type(mx::dict_encoding::cbor)) == "application/cbor");
+    CHECK(std::string(mx::mime_type(mx::dict_encoding::msgpack)) == "application/msgpack");
+
+    CHECK(mx::encoding_for_mime_type("application/cbor") == mx::dict_encoding::cbor);
+    CHECK(mx::encoding_for_mime_type("application/msgpack") == mx::dict_encoding::msgpack);
+    CHECK(mx::encoding_for_mime_type("application/json") == mx::dict_encoding::json);
+    CHECK(mx::encoding_for_mime_type("") == mx::dict_encoding::json);
+}
+
+TEST_CASE("dict_encoding: a nested document reads back unchanged") {
+    const nl::json doc = {
+        {"name", "osc"},
+        {"on", true},
+        {"off", false},
+        {"nothing", nullptr},
+        {"freq", 440.5},
+        {"voices", nl::json::array({1, -2, 3.25, "four", nl::json::object(), nl::json::array()})},
+        {"sub", {{"a", {{"b", {{"c", 1}}}}}}},
+        {"unicode", "caf\xC3\xA9 \xF0\x9F\x8E\xB9"},
+    };
+    CHECK(via_cbor(doc) == doc);
+    CHECK(via_msgpack(doc) == doc);
+}
+
+TEST_CASE("dict_encoding: integers match nl::json's encoders byte for byte") {
+    const nl::json ints = boundary_integers();
+    std::vector<char> cbor;
+    mx::encode_cbor(snapshot_of(ints), cbor);
+    CHECK(cbor == as_chars(nl::json::to_cbor(ints)));
+
+    std::vector<char> msgpack;
+    mx::encode_msgpack(snapshot_of(ints), msgpack);
+    CHECK(msgpack == as_chars(nl::json::to_msgpack(ints)));
+}
+
+TEST_CASE("dict_encoding: string and container lengths at every width") {
+    nl::json doc = nl::json::object();
+    for (size_t n : {0, 23, 24, 31, 32, 255, 256, 65535, 65536}) {
+        doc["s" + std::to_string(n)] = std::string(n, 'x');
+    }
+    for (size_t n : {15, 16, 23, 24, 65535, 65536}) {
+        doc["a" + std::to_string(n)] = nl::json(std::vector<int>(n, 7));
+    }
+    nl::json wide = nl::json::object();
+    for (int i = 0; i < 70000; ++i) {
+        wide["k" + std::to_string(i)] = i;
+    }
+    doc["wide"] = wide;
+
+    CHECK(via_cbor(doc) == doc);
+    CHECK(via_msgpack(doc) == doc);
+
+    // With only strings, ints and sorted keys there is one shortest encoding.
+    std::vector<char> cbor;
+    mx::encode_cbor(snapshot_of(doc), cbor);
+    CHECK(cbor == as_chars(nl::json::to_cbor(doc)));
+    std::vector<char> msgpack;
+    mx::encode_msgpack(snapshot_of(doc), msgpack);
+    CHECK(msgpack == as_chars(nl::json::to_msgpack(doc)));
+}
+
+TEST_CASE("dict_encoding: doubles are float64 and exact") {
+    const nl::json doubles = nl::json::array({0.0, -0.5, 0.1, 1e300, -2.5e-308,
+                                              std::numeric_limits<double>::max()});
+    const nl::json cbor = via_cbor(doubles);
+    const nl::json msgpack = via_msgpack(doubles);
+    for (size_t i = 0; i < doubles.size(); ++i) {
+        CHECK(cbor[i].is_number_float());
+        CHECK(cbor[i].get<double>() == doubles[i].get<double>());
+        CHECK(msgpack[i].get<double>() == doubles[i].get<double>());
+    }
+
+    std::vector<char> bytes;
+    mx::dict_snapshot s;
+    s.value(1.0);
+    mx::encode_cbor(s, bytes);
+    CHECK(bytes.size() == 9);
+    CHECK(static_cast<unsigned char>(bytes[0]) == 0xFB);
+}
+
+TEST_CASE("dict_encoding: invalid UTF-8 is replaced, never passed through") {
+    const std::string replacement = "\xEF\xBF\xBD";
+    mx::dict_snapshot s;
+    s.begin_object();
+    s.key("k\xFF");
+    s.value("a\xC0\xAF" "b");
+    s.key("caf\xC3\xA9");
+    s.value("\xE2\x82");
+    s.end_object();
+
+    for (auto encode : {&mx::encode_cbor, &mx::encode_msgpack}) {
+        std::vector<char> bytes;
+        encode(s, bytes);
+        const nl::json back = encode == &mx::encode_cbor ? nl::json::from_cbor(bytes)
+                                                         : nl::json::from_msgpack(bytes);
+        CHECK(back.at("k" + replacement) == "a" + replacement + replacement + "b");
+        // Valid text is untouched.
+        CHECK(back.at("caf\xC3\xA9") == replacement + replacement);
+        // nl::json's dump throws on invalid UTF-8.
+        CHECK_NOTHROW(back.dump());
+    }
+}
+
+TEST_CASE("dict_encoding: keys keep the snapshot's order") {
+    mx::dict_snapshot s;
+    s.begin_object();
+    s.key("z");
+    s.value(1);
+    s.key("a");
+    s.value(2);
+    s.end_object();
+
+    std::vector<char> bytes;
+    mx::encode_msgpack(s, bytes);
+    // fixmap(2), fixstr "z", 1, fixstr "a", 2
+    const std::vector<char> expected{'\x82', '\xA1', 'z', '\x01', '\xA1', 'a', '\x02'};
+    CHECK(bytes == expected);
+}
@@ -0,0 +1,85 @@
+// Tests for dict_snapshot -- the flat copy `dict` takes of a Max dictionary
+// so that JSON encoding can happen on the server thread.
+
+#include "doctest.h"
+
+#include "../dict_snapshot.h"
+#include "../json_writer.h"
+
+#include <string>
+
+namespace {
+
+// Every kind of record, nested.
+template <typename Out>
+void write_sample(Out& out) {
+    out.begin_object();
+    out.key("name");
+    out.value("osc");
+    out.key("voices");
+    out.begin_array();
+    out.value(1);
+    out.value(-2.5);
+    out.value(true);
+    out.value(false);
+    out.null();
+    out.begin_object();
+    out.end_object();
+    out.end_array();
+    out.key("");
+    out.value("");
+    out.end_object();
+}
+
+std::string encode(const mx::dict_snapshot& snapshot, int indent) {
+    std::string text;
+    mx::json_writer out(text, indent);
+    snapshot.replay(out);
+    return text;
+}
+
+} // namespace
+
+TEST_CASE("dict_snapshot replays exactly what was written") {
+    mx::dict_snapshot snapshot;
+    write_sample(snapshot);
+
+    for (int indent : {-1, 2}) {
+        std::string direct;
+        mx::json_writer out(direct, indent);
+        write_sample(out);
+        CHECK(encode(snapshot, indent) == direct);
+    }
+}
+
+TEST_CASE("dict_snapshot keeps all text in one buffer") {
+    mx::dict_snapshot snapshot;
+    snapshot.begin_object();
+    snapshot.key("code");
+    snapshot.value(std::string_view("a\0b", 3));
+    snapshot.end_object();
+
+    CHECK(snapshot.size() == 4);
+    CHECK(snapshot.text_bytes() == 7);
+    CHECK(encode(snapshot, -1) == "{\"code\":\"a\\u0000b\"}");
+}
+
+TEST_CASE("dict_snapshot keeps integers and doubles exact") {
+    mx::dict_snapshot snapshot;
+    snapshot.begin_array();
+    snapshot.value(9007199254740993LL);
+    snapshot.value(0.1);
+    snapshot.end_array();
+    CHECK(encode(snapshot, -1) == "[9007199254740993,0.1]");
+}
+
+TEST_CASE("dict_snapshot clear empties it for reuse") {
+    mx::dict_snapshot snapshot;
+    write_sample(snapshot);
+    CHECK_FALSE(snapshot.empty());
+
+    snapshot.clear();
+    CHECK(snapshot.empty());
+    CHECK(snapshot.text_bytes() == 0);
+    CHECK(encode(snapshot, 2).empty());
+}
@@ -8,7 +8,10 @@
 #include "../types.h"
 #include "../version.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <string>
 #include <thread>
 #include <vector>
@@ -23,6 +26,7 @@ struct published_message {
     std::string msg_type;
     nl::json content;
     nl::json parent; // header of the request this was attributed to
+    xeus::buffer_sequence buffers;
 };
 
 // Drives a max_interpreter and records everything it publishes.
@@ -36,8 +40,9 @@ struct harness {
         impl.set_notifier([this] { ++notify_count; });
         interp.register_publisher(
             [this](xeus::xrequest_context ctx, const std::string& msg_type,
-                   nl::json, nl::json content, xeus::buffer_sequence) {
-                published.push_back({msg_type, std::move(content), ctx.header()});
+                   nl::json, nl::json content, xeus::buffer_sequence buffers) {
+                published.push_back({msg_type, std::move(content), ctx.header(),
+                                     std::move(buffers)});
             });
     }
 
@@ -266,11 +271,31 @@ TEST_CASE("execute pushes code to the outlet and wakes the main thread") {
 
     auto msg = h.impl.outlet_queue.try_pop();
     REQUIRE(msg.has_value());
-    CHECK(msg->selector == "code");
+    CHECK(msg->selector == mx::outlet_selector::code);
     CHECK(msg->outlet_index == 0);
-    REQUIRE(msg->atoms.size() == 2);
-    CHECK(std::get<std::string>(msg->atoms[0]) == "execute");
-    CHECK(std::get<std::string>(msg->atoms[1]) == "hello world");
+    REQUIRE(msg->size() == 2);
+    CHECK(msg->symbol(0) == "execute");
+    CHECK(msg->symbol(1) == "hello world");
+    // Marked as the cell's source, for the external to deliver per @delivery.
+    CHECK(msg->body_index == 1);
+}
+
+TEST_CASE("with @tokenize, the cell arrives as typed atoms") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.tokenize.store(true);
+
+    h.execute("metro 100 0.5");
+
+    auto msg = h.impl.outlet_queue.try_pop();
+    REQUIRE(msg.has_value());
+    REQUIRE(msg->size() == 4);
+    CHECK(msg->symbol(0) == "execute");
+    CHECK(msg->symbol(1) == "metro");
+    CHECK(msg->integer(2) == 100);
+    CHECK(msg->real(3) == 0.5);
+    // No single atom is the source, so @delivery has nothing to act on.
+    CHECK(msg->body_index == -1);
 }
 
 TEST_CASE("execution_input is published exactly once") {
@@ -326,6 +351,208 @@ TEST_CASE("a result carrying a mime type is published under that mime type") {
     CHECK(results[0].content["data"]["application/json"] == "{\"freq\":440}");
 }
 
+TEST_CASE("a dictionary snapshot is encoded as JSON by the interpreter") {
+    harness h;
+    h.impl.timeout.store(5);
+
+    max_side responder([&h] {
+        while (h.impl.current_execution.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mx::ResultMessage r;
+        r.snapshot = std::make_unique<mx::dict_snapshot>();
+        r.snapshot->begin_object();
+        r.snapshot->key("freq");
+        r.snapshot->value(440);
+        r.snapshot->key("wave");
+        r.snapshot->value("sine");
+        r.snapshot->end_object();
+        r.mime_type = "application/json";
+        h.reply_from_max(std::move(r));
+    });
+
+    h.execute("dump state");
+
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].content["data"]["application/json"]
+          == "{\n  \"freq\": 440,\n  \"wave\": \"sine\"\n}");
+}
+
+TEST_CASE("an array result is published as a binary buffer") {
+    harness h;
+    h.impl.timeout.store(5);
+
+    max_side responder([&h] {
+        while (h.impl.current_execution.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mx::ResultMessage r;
+        r.array = std::make_unique<mx::typed_array>();
+        r.array->add(1LL);
+        r.array->add(0.5);
+        r.array->add(-2.25);
+        h.reply_from_max(std::move(r));
+    });
+
+    nl::json reply = h.execute("levels");
+    CHECK(reply["status"] == "ok");
+
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 1);
+    const auto& result = results[0];
+    CHECK(result.content["data"]["text/plain"] == "array(float64, shape=[3])");
+
+    const auto& meta = result.content["metadata"]["array"];
+    CHECK(meta["dtype"] == "float64");
+    CHECK(meta["shape"] == nl::json::array({3}));
+    CHECK(meta["byteorder"] == mx::host_byte_order());
+    CHECK(meta["buffer"] == 0);
+
+    REQUIRE(result.buffers.size() == 1);
+    REQUIRE(result.buffers[0].size() == 3 * sizeof(double));
+    double values[3];
+    std::memcpy(values, result.buffers[0].data(), sizeof(values));
+    CHECK(values[0] == 1.0);
+    CHECK(values[1] == 0.5);
+    CHECK(values[2] == -2.25);
+}
+
+TEST_CASE("a CBOR dictionary result is published as a binary buffer") {
+    harness h;
+    h.impl.timeout.store(5);
+
+    max_side responder([&h] {
+        while (h.impl.current_execution.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mx::ResultMessage r;
+        r.snapshot = std::make_unique<mx::dict_snapshot>();
+        r.snapshot->begin_object();
+        r.snapshot->key("freq");
+        r.snapshot->value(440);
+        r.snapshot->end_object();
+        r.mime_type = "application/cbor";
+        h.reply_from_max(std::move(r));
+    });
+
+    h.execute("dump state");
+
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 1);
+    const auto& result = results[0];
+    CHECK_FALSE(result.content["data"].contains("application/json"));
+    CHECK(result.content["data"]["text/plain"] == "application/cbor, 9 bytes");
+    CHECK(result.content["metadata"]["encoded"]["mime_type"] == "application/cbor");
+    CHECK(result.content["metadata"]["encoded"]["buffer"] == 0);
+
+    REQUIRE(result.buffers.size() == 1);
+    CHECK(nl::json::from_cbor(result.buffers[0]) == nl::json{{"freq", 440}});
+}
+
+TEST_CASE("a MessagePack dictionary result outside a cell streams its description") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    mx::ResultMessage r;
+    r.snapshot = std::make_unique<mx::dict_snapshot>();
+    r.snapshot->begin_array();
+    r.snapshot->value(1LL);
+    r.snapshot->end_array();
+    r.mime_type = "application/msgpack";
+    r.stream_name = "stdout";
+    h.impl.async_queue.push(std::move(r));
+
+    h.execute("anything");
+
+    auto streams = h.of_type("stream");
+    REQUIRE(streams.size() == 1);
+    CHECK(streams[0].content["text"] == "application/msgpack, 2 bytes\n");
+}
+
+TEST_CASE("with @diff a dictionary published again is sent as a JSON Patch") {
+    harness h;
+    h.impl.timeout.store(5);
+    h.impl.dict_diff.store(2);
+
+    const auto send_state = [&h](int cell, long long tempo) {
+        max_side responder([&h, cell, tempo] {
+            while (h.impl.current_execution.load() != cell) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            mx::ResultMessage r;
+            r.snapshot = std::make_unique<mx::dict_snapshot>();
+            r.snapshot->begin_object();
+            r.snapshot->key("tempo");
+            r.snapshot->value(tempo);
+            r.snapshot->end_object();
+            r.mime_type = "application/json";
+            r.dict_name = "state";
+            h.reply_from_max(std::move(r));
+        });
+        h.execute("dump state");
+    };
+    send_state(1, 120);
+    send_state(2, 121);
+    send_state(3, 122);
+
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 3);
+
+    CHECK(results[0].content["data"]["application/json"] == "{\n  \"tempo\": 120\n}");
+    CHECK(results[0].content["metadata"]["diff"]
+          == nl::json{{"dict", "state"}, {"sequence", 0}, {"full", true}});
+
+    CHECK(results[1].content["data"]["application/json-patch+json"]
+          == R"([{"op":"replace","path":"/tempo","value":121}])");
+    CHECK(results[1].content["metadata"]["diff"]["full"] == false);
+    CHECK(results[1].content["metadata"]["diff"]["sequence"] == 1);
+
+    // Every second update is a resync.
+    CHECK(results[2].content["data"].contains("application/json"));
+    CHECK(results[2].content["metadata"]["diff"]["full"] == true);
+}
+
+TEST_CASE("other results carry no buffers") {
+    harness h;
+    h.impl.timeout.store(5);
+
+    max_side responder([&h] {
+        while (h.impl.current_execution.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mx::ResultMessage r;
+        r.text = "42";
+        h.reply_from_max(std::move(r));
+    });
+
+    h.execute("answer");
+
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].buffers.empty());
+    CHECK(results[0].content["metadata"] == nl::json::object());
+}
+
+TEST_CASE("a dictionary snapshot outside a cell is encoded as stream text") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    mx::ResultMessage r;
+    r.snapshot = std::make_unique<mx::dict_snapshot>();
+    r.snapshot->begin_array();
+    r.snapshot->value(1.5);
+    r.snapshot->end_array();
+    r.stream_name = "stdout";
+    h.impl.async_queue.push(std::move(r));
+
+    h.execute("anything");
+
+    auto streams = h.of_type("stream");
+    REQUIRE(streams.size() == 1);
+    CHECK(streams[0].content["text"] == "[\n  1.5\n]\n");
+}
+
 TEST_CASE("an error result fails the cell") {
     harness h;
     h.impl.timeout.store(5);
@@ -400,13 +627,14 @@ TEST_CASE("stream output is newline terminated") {
 
     h.execute("long job");
 
-    auto streams = h.of_type("stream");
-    REQUIRE(streams.size() == 2);
-
     // Jupyter concatenates stream text verbatim. Without the newline the two
-    // lines run together and the next Out[n] collides with them.
-    CHECK(streams[0].content["text"] == "working on it\n");
-    CHECK(streams[1].content["text"] == "still going\n");
+    // lines run together and the next Out[n] collides with them. That holds
+    // whether they are published separately or batched into one message.
+    std::string text;
+    for (const auto& s : h.of_type("stream")) {
+        text += s.content["text"].get<std::string>();
+    }
+    CHECK(text == "working on it\nstill going\n");
 }
 
 TEST_CASE("stream output already ending in a newline is not doubled") {
@@ -585,7 +813,7 @@ TEST_CASE("shutdown_request does not permanently disarm the interpreter") {
     // The patch is told about it via the status outlet.
     auto msg = h.impl.outlet_queue.try_pop();
     REQUIRE(msg.has_value());
-    CHECK(msg->selector == "shutdown");
+    CHECK(msg->selector == mx::outlet_selector::shutdown);
     CHECK(msg->outlet_index == 1);
 
     // Clearing the flag, as kernel_start does, restores normal waiting.
@@ -647,3 +875,535 @@ TEST_CASE("a cleared notifier is not called") {
     // The message is still queued; only the wake-up is suppressed.
     CHECK(h.impl.outlet_queue.size() == 1);
 }
+
+TEST_CASE("a burst of outlet messages calls the notifier once per drain") {
+    mx::t_kernel_impl impl;
+    int calls = 0;
+    impl.set_notifier([&calls] { ++calls; });
+
+    std::vector<mx::OutletMessage> drained;
+    for (int burst = 0; burst < 10; ++burst) {
+        for (int i = 0; i < 1000; ++i) {
+            impl.outlet_queue.push(mx::OutletMessage{});
+            impl.notify_main_thread();
+        }
+        // What the qelem does when it runs.
+        impl.clear_notify_pending();
+        impl.outlet_queue.drain_into(drained);
+    }
+
+    CHECK(drained.size() == 10000);
+    CHECK(calls == 10);
+}
+
+TEST_CASE("coalesced notification loses no message across threads") {
+    mx::t_kernel_impl impl;
+    std::atomic<int> calls{0};
+    impl.set_notifier([&calls] { calls.fetch_add(1); });
+
+    constexpr int k_messages = 10000;
+    std::thread server([&impl] {
+        for (int i = 0; i < k_messages;) {
+            mx::OutletMessage msg;
+            msg.execution_counter = i;
+            if (impl.outlet_queue.push(std::move(msg))) {
+                impl.notify_main_thread();
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // The main thread only drains when notified, like the qelem. A lost
+    // wake-up leaves messages behind and this runs into its deadline.
+    std::vector<mx::OutletMessage> drained;
+    int seen = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (static_cast<int>(drained.size()) < k_messages
+           && std::chrono::steady_clock::now() < deadline) {
+        if (calls.load() == seen) {
+            std::this_thread::yield();
+            continue;
+        }
+        seen = calls.load();
+        impl.clear_notify_pending();
+        impl.outlet_queue.drain_into(drained);
+    }
+    server.join();
+
+    REQUIRE(drained.size() == static_cast<size_t>(k_messages));
+    bool in_order = true;
+    for (int i = 0; i < k_messages; ++i) {
+        in_order = in_order && drained[i].execution_counter == i;
+    }
+    CHECK(in_order);
+    CHECK(calls.load() < k_messages);
+}
+
+TEST_CASE("a notification with no notifier set does not disarm the next one") {
+    mx::t_kernel_impl impl;
+    impl.notify_main_thread();
+
+    int calls = 0;
+    impl.set_notifier([&calls] { ++calls; });
+    impl.notify_main_thread();
+    CHECK(calls == 1);
+
+    // And clear_notifier still means never again.
+    impl.clear_notify_pending();
+    impl.clear_notifier();
+    impl.notify_main_thread();
+    CHECK(calls == 1);
+}
+
+TEST_CASE("with @concurrency, several cells are handed to Max at once") {
+    harness h;
+    h.impl.timeout.store(30);
+    h.impl.concurrency.store(3);
+
+    nl::json r[4];
+    bool d[4] = {false, false, false, false};
+    for (int i = 0; i < 4; ++i) {
+        h.begin("cell " + std::to_string(i + 1), &r[i], &d[i]);
+    }
+
+    // Three in flight, the fourth queued behind the limit.
+    CHECK(h.impl.pending_executions.load() == 4);
+    REQUIRE(h.impl.outlet_queue.size() == 3);
+
+    // Each carries its counter, so the patch can say which cell it answers.
+    for (int i = 1; i <= 3; ++i) {
+        auto msg = h.impl.outlet_queue.try_pop();
+        REQUIRE(msg.has_value());
+        CHECK(msg->selector == mx::outlet_selector::code);
+        REQUIRE(msg->size() == 3);
+        CHECK(msg->symbol(0) == "cell");
+        CHECK(msg->integer(1) == i);
+        CHECK(msg->symbol(2) == "cell " + std::to_string(i));
+        CHECK(msg->body_index == 2);
+    }
+
+    h.impl.alive.store(false);
+    h.interp.on_idle();
+    for (bool done : d) {
+        CHECK(done);
+    }
+}
+
+TEST_CASE("results are routed by counter, so a slow cell does not block the rest") {
+    harness h;
+    h.impl.timeout.store(30);
+    h.impl.concurrency.store(2);
+
+    nl::json r1, r2, r3;
+    bool d1 = false, d2 = false, d3 = false;
+
+    h.interp.execute_request(labelled("cell-one"),
+                             [&](nl::json r) { r1 = std::move(r); d1 = true; },
+                             "slow", xeus::execute_request_config{false, true, false},
+                             nl::json::object());
+    h.interp.execute_request(labelled("cell-two"),
+                             [&](nl::json r) { r2 = std::move(r); d2 = true; },
+                             "fast", xeus::execute_request_config{false, true, false},
+                             nl::json::object());
+    h.interp.execute_request(labelled("cell-three"),
+                             [&](nl::json r) { r3 = std::move(r); d3 = true; },
+                             "queued", xeus::execute_request_config{false, true, false},
+                             nl::json::object());
+    REQUIRE(h.impl.outlet_queue.size() == 2);
+
+    // Cell two answers while cell one is still working.
+    mx::ResultMessage progress;
+    progress.stream_name = "stdout";
+    progress.text = "from cell two";
+    progress.execution_counter = 2;
+    h.impl.result_queue.push(std::move(progress));
+
+    mx::ResultMessage two;
+    two.text = "two";
+    two.execution_counter = 2;
+    h.impl.result_queue.push(std::move(two));
+    h.interp.on_idle();
+
+    CHECK(!d1);
+    CHECK(d2);
+    CHECK(r2["status"] == "ok");
+    CHECK(r2["execution_count"] == 2);
+
+    // Its slot went straight to cell three.
+    CHECK(h.impl.outlet_queue.size() == 3);
+    CHECK(h.impl.pending_executions.load() == 2);
+
+    // Output went to the cell that produced it, not the oldest one.
+    auto streams = h.of_type("stream");
+    REQUIRE(streams.size() == 1);
+    CHECK(streams[0].parent["msg_id"] == "cell-two");
+    auto results = h.of_type("execute_result");
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].parent["msg_id"] == "cell-two");
+    CHECK(results[0].content["execution_count"] == 2);
+
+    // An unstamped-looking reply answers the oldest cell in flight.
+    CHECK(h.impl.current_execution.load() == 1);
+    mx::ResultMessage one;
+    one.text = "one";
+    one.execution_counter = h.impl.current_execution.load();
+    h.impl.result_queue.push(std::move(one));
+    h.interp.on_idle();
+
+    CHECK(d1);
+    CHECK(!d3);
+    CHECK(h.impl.current_execution.load() == 3);
+
+    mx::ResultMessage three;
+    three.text = "three";
+    three.execution_counter = 3;
+    h.impl.result_queue.push(std::move(three));
+    h.interp.on_idle();
+
+    CHECK(d3);
+    CHECK(h.impl.pending_executions.load() == 0);
+    CHECK(h.impl.current_execution.load() == 0);
+}
+
+TEST_CASE("with @concurrency, a reply for a cell not in flight is discarded") {
+    harness h;
+    h.impl.timeout.store(30);
+    h.impl.concurrency.store(2);
+
+    nl::json r1;
+    bool d1 = false;
+    h.begin("only cell", &r1, &d1);
+
+    mx::ResultMessage stray;
+    stray.text = "for a cell that never ran";
+    stray.execution_counter = 7;
+    h.impl.result_queue.push(std::move(stray));
+    h.interp.on_idle();
+
+    CHECK(!d1);
+    CHECK(h.of_type("execute_result").empty());
+
+    h.impl.alive.store(false);
+    h.interp.on_idle();
+    CHECK(d1);
+}
+
+TEST_CASE("consecutive stream lines go out as one message per tick") {
+    harness h;
+    h.impl.timeout.store(30);
+
+    nl::json reply;
+    bool done = false;
+    h.begin("chatty", &reply, &done);
+
+    for (int i = 0; i < 100; ++i) {
+        mx::ResultMessage line;
+        line.stream_name = "stdout";
+        line.text = "line " + std::to_string(i);
+        h.reply_from_max(std::move(line));
+    }
+    h.interp.on_idle();
+
+    auto streams = h.of_type("stream");
+    REQUIRE(streams.size() == 1);
+    const std::string text = streams[0].content["text"];
+    CHECK(text.rfind("line 0\nline 1\n", 0) == 0);
+    CHECK(text.size() > 99 * 7);
+    CHECK(text.substr(text.size() - 8) == "line 99\n");
+
+    h.impl.alive.store(false);
+    h.interp.on_idle();
+    CHECK(done);
+}
+
+TEST_CASE("batched stream output is published before the result that follows it") {
+    harness h;
+    h.impl.timeout.store(30);
+
+    nl::json reply;
+    bool done = false;
+    h.begin("job", &reply, &done);
+
+    for (const char* text : {"one", "two"}) {
+        mx::ResultMessage line;
+        line.stream_name = "stdout";
+        line.text = text;
+        h.reply_from_max(std::move(line));
+    }
+    mx::ResultMessage answer;
+    answer.text = "done";
+    h.reply_from_max(std::move(answer));
+    h.interp.on_idle();
+    REQUIRE(done);
+
+    std::vector<std::string> order;
+    for (const auto& p : h.published) {
+        if (p.msg_type == "stream" || p.msg_type == "execute_result") {
+            order.push_back(p.msg_type);
+        }
+    }
+    REQUIRE(order.size() == 2);
+    CHECK(order[0] == "stream");
+    CHECK(order[1] == "execute_result");
+    CHECK(h.of_type("stream")[0].content["text"] == "one\ntwo\n");
+}
+
+TEST_CASE("a change of stream name starts a new batch, preserving order") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    for (const char* name : {"stdout", "stdout", "stderr", "stdout"}) {
+        mx::ResultMessage note;
+        note.stream_name = name;
+        note.text = name;
+        h.impl.async_queue.push(std::move(note));
+    }
+    h.interp.on_idle();
+
+    auto streams = h.of_type("stream");
+    REQUIRE(streams.size() == 3);
+    CHECK(streams[0].content["name"] == "stdout");
+    CHECK(streams[0].content["text"] == "stdout\nstdout\n");
+    CHECK(streams[1].content["name"] == "stderr");
+    CHECK(streams[2].content["name"] == "stdout");
+}
+
+TEST_CASE("the stream byte cap splits a batch, and 0 disables batching") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    SUBCASE("cap") {
+        h.impl.stream_batch_bytes.store(16);
+        for (int i = 0; i < 4; ++i) {
+            mx::ResultMessage note;
+            note.stream_name = "stdout";
+            note.text = "1234567"; // 8 bytes with its newline
+            h.impl.async_queue.push(std::move(note));
+        }
+        h.interp.on_idle();
+
+        auto streams = h.of_type("stream");
+        REQUIRE(streams.size() == 2);
+        CHECK(streams[0].content["text"] == "1234567\n1234567\n");
+        CHECK(streams[1].content["text"] == "1234567\n1234567\n");
+    }
+
+    SUBCASE("disabled") {
+        h.impl.stream_batch_bytes.store(0);
+        for (int i = 0; i < 3; ++i) {
+            mx::ResultMessage note;
+            note.stream_name = "stdout";
+            note.text = "line";
+            h.impl.async_queue.push(std::move(note));
+        }
+        h.interp.on_idle();
+
+        auto streams = h.of_type("stream");
+        REQUIRE(streams.size() == 3);
+        for (const auto& s : streams) {
+            CHECK(s.content["text"] == "line\n");
+        }
+    }
+}
+
+namespace {
+
+// Queue `count` free-standing stdout lines of `text`.
+void flood(harness& h, int count, const std::string& text) {
+    for (int i = 0; i < count; ++i) {
+        mx::ResultMessage note;
+        note.stream_name = "stdout";
+        note.text = text;
+        h.impl.async_queue.push(std::move(note));
+    }
+}
+
+// Total stdout lines published, however they were batched.
+size_t stdout_lines(const harness& h) {
+    size_t lines = 0;
+    for (const auto& s : h.of_type("stream")) {
+        if (s.content["name"] != "stdout") continue;
+        const std::string text = s.content["text"];
+        lines += static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST_CASE("stream output beyond the message rate is dropped and summarised once") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.iopub_rate_window_ms.store(100);
+    h.impl.iopub_msg_rate_limit.store(100); // 10 messages per 100ms window
+    h.impl.iopub_data_rate_limit.store(0);
+    h.impl.stream_batch_bytes.store(0); // one message per line
+
+    flood(h, 25, "x");
+    h.interp.on_idle();
+    CHECK(stdout_lines(h) == 10);
+    CHECK(h.impl.suppressed_messages.load() == 15);
+    CHECK(h.impl.suppressed_bytes.load() == 15);
+
+    // Nothing is reported until the window closes...
+    for (const auto& s : h.of_type("stream")) {
+        CHECK(s.content["name"] == "stdout");
+    }
+
+    // ...and then exactly once, even on an idle tick with no new output.
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    h.interp.on_idle();
+    h.interp.on_idle();
+
+    std::vector<std::string> summaries;
+    for (const auto& s : h.of_type("stream")) {
+        if (s.content["name"] == "stderr") summaries.push_back(s.content["text"]);
+    }
+    REQUIRE(summaries.size() == 1);
+    CHECK(summaries[0].find("15 messages / 15 bytes") != std::string::npos);
+
+    // A fresh window admits output again.
+    flood(h, 5, "y");
+    h.interp.on_idle();
+    CHECK(stdout_lines(h) == 15);
+}
+
+TEST_CASE("the message rate counts IOPub messages, not lines") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.iopub_rate_window_ms.store(1000);
+    h.impl.iopub_msg_rate_limit.store(2); // 2 messages per window
+    h.impl.iopub_data_rate_limit.store(0);
+
+    // 25 lines batched into one message on each of three ticks: the first two
+    // messages fit, and all of the third's lines are dropped.
+    for (int tick = 0; tick < 3; ++tick) {
+        flood(h, 25, "x");
+        h.interp.on_idle();
+    }
+    CHECK(h.of_type("stream").size() == 2);
+    CHECK(stdout_lines(h) == 50);
+    CHECK(h.impl.suppressed_messages.load() == 25);
+}
+
+TEST_CASE("output Max cannot queue is dropped, counted and reported") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.iopub_rate_window_ms.store(50);
+    h.impl.iopub_msg_rate_limit.store(0);
+    h.impl.iopub_data_rate_limit.store(0);
+
+    const int capacity = static_cast<int>(h.impl.async_queue.capacity());
+    REQUIRE(capacity > 0);
+    flood(h, capacity + 5, "x");
+    CHECK(h.impl.async_queue.dropped() == 5);
+
+    h.interp.on_idle();
+    CHECK(stdout_lines(h) == static_cast<size_t>(capacity));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    h.interp.on_idle();
+    h.interp.on_idle();
+
+    std::vector<std::string> summaries;
+    for (const auto& s : h.of_type("stream")) {
+        if (s.content["name"] == "stderr") summaries.push_back(s.content["text"]);
+    }
+    REQUIRE(summaries.size() == 1);
+    CHECK(summaries[0] == "[kernel] 5 messages from Max dropped (queue full)\n");
+}
+
+TEST_CASE("stream output beyond the data rate is dropped") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.iopub_rate_window_ms.store(1000);
+    h.impl.iopub_msg_rate_limit.store(0);
+    h.impl.iopub_data_rate_limit.store(100); // 100 bytes per window
+
+    flood(h, 20, "123456789"); // 9 bytes each, so 11 fit
+    h.interp.on_idle();
+    CHECK(stdout_lines(h) == 11);
+    CHECK(h.impl.suppressed_messages.load() == 9);
+    CHECK(h.impl.suppressed_bytes.load() == 81);
+}
+
+TEST_CASE("rate limits of 0 publish everything") {
+    harness h;
+    h.impl.timeout.store(0);
+    h.impl.iopub_msg_rate_limit.store(0);
+    h.impl.iopub_data_rate_limit.store(0);
+
+    flood(h, 5000, "metro tick");
+    h.interp.on_idle();
+    CHECK(stdout_lines(h) == 5000);
+    CHECK(h.impl.suppressed_messages.load() == 0);
+}
+
+TEST_CASE("results and errors are never rate limited") {
+    harness h;
+    h.impl.iopub_msg_rate_limit.store(1);
+    h.impl.iopub_rate_window_ms.store(1000);
+
+    for (int i = 0; i < 3; ++i) {
+        mx::ResultMessage answer;
+        answer.text = "ok";
+        max_side max([&] {
+            while (h.impl.current_execution.load() == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            h.reply_from_max(std::move(answer));
+        });
+        auto reply = h.execute("cell");
+        CHECK(reply["status"] == "ok");
+    }
+    CHECK(h.of_type("execute_result").size() == 3);
+}
+
+TEST_CASE("delivered outlet messages are reused for later cells") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    h.execute("first");
+    auto msg = h.impl.outlet_queue.try_pop();
+    REQUIRE(msg.has_value());
+    h.impl.recycle(std::move(*msg));
+    CHECK(h.impl.outlet_free.size() == 1);
+
+    // The next cell takes it back off the free list, emptied.
+    h.execute("second");
+    CHECK(h.impl.outlet_free.empty());
+    msg = h.impl.outlet_queue.try_pop();
+    REQUIRE(msg.has_value());
+    REQUIRE(msg->size() == 2);
+    CHECK(msg->symbol(1) == "second");
+}
+
+TEST_CASE("a cell waits in the queue while outlet_queue is full") {
+    harness h;
+    h.impl.timeout.store(0);
+
+    // Max has stopped draining: fill the ring behind the interpreter's back.
+    const size_t capacity = h.impl.outlet_queue.capacity();
+    for (size_t i = 0; i < capacity; ++i) {
+        REQUIRE(h.impl.outlet_queue.push(mx::OutletMessage{}));
+    }
+
+    nl::json reply;
+    bool done = false;
+    h.begin("patience", &reply, &done);
+    h.interp.on_idle();
+    CHECK(!done);
+    CHECK(h.impl.current_execution.load() == 0);
+    CHECK(h.impl.pending_executions.load() == 1);
+
+    // Once Max catches up the cell goes out, and only once.
+    h.impl.outlet_queue.clear();
+    h.interp.on_idle();
+    CHECK(done);
+    CHECK(reply["status"] == "ok");
+    REQUIRE(h.impl.outlet_queue.size() == 1);
+    auto msg = h.impl.outlet_queue.try_pop();
+    CHECK(msg->symbol(msg->size() - 1) == "patience");
+}
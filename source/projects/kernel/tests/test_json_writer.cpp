@@ -0,0 +1,171 @@
+// Tests for json_writer -- the streaming writer behind `dict`. Output is
+// checked as text, and against nl::json both as a parser and, for the
+// layout, as the writer it replaced.
+
+#include "doctest.h"
+
+#include "../json_writer.h"
+
+#include <limits>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace {
+
+// The nested document used by several tests, keys in sorted order so that
+// nl::json, which sorts, lays it out the same way.
+void write_sample(mx::json_writer& w) {
+    w.begin_object();
+    w.key("empty_array");
+    w.begin_array();
+    w.end_array();
+    w.key("empty_object");
+    w.begin_object();
+    w.end_object();
+    w.key("list");
+    w.begin_array();
+    w.value(1);
+    w.value("two");
+    w.begin_object();
+    w.key("three");
+    w.value(3.5);
+    w.end_object();
+    w.end_array();
+    w.key("name");
+    w.value("osc");
+    w.key("on");
+    w.value(true);
+    w.key("sub");
+    w.begin_object();
+    w.key("freq");
+    w.value(440.0);
+    w.key("nothing");
+    w.null();
+    w.end_object();
+    w.end_object();
+}
+
+nl::json sample_document() {
+    return nl::json{
+        {"empty_array", nl::json::array()},
+        {"empty_object", nl::json::object()},
+        {"list", nl::json::array({1, "two", nl::json{{"three", 3.5}}})},
+        {"name", "osc"},
+        {"on", true},
+        {"sub", nl::json{{"freq", 440.0}, {"nothing", nullptr}}},
+    };
+}
+
+std::string write_value(double number) {
+    std::string out;
+    mx::json_writer w(out);
+    w.value(number);
+    return out;
+}
+
+std::string write_string(const std::string& text) {
+    std::string out;
+    mx::json_writer w(out);
+    w.value(text);
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("json_writer: compact output") {
+    std::string out;
+    mx::json_writer w(out);
+    write_sample(w);
+    CHECK(out == sample_document().dump());
+}
+
+TEST_CASE("json_writer: pretty output matches nl::json's layout") {
+    for (int indent : {0, 2, 4}) {
+        std::string out;
+        mx::json_writer w(out, indent);
+        write_sample(w);
+        CHECK_MESSAGE(out == sample_document().dump(indent), indent);
+    }
+}
+
+TEST_CASE("json_writer: keys keep the order they were written in") {
+    std::string out;
+    mx::json_writer w(out);
+    w.begin_object();
+    w.key("z");
+    w.value(1);
+    w.key("a");
+    w.value(2);
+    w.end_object();
+    CHECK(out == R"({"z":1,"a":2})");
+}
+
+TEST_CASE("json_writer: top-level scalars and appending") {
+    std::string out = "x=";
+    mx::json_writer w(out);
+    w.value(-42);
+    CHECK(out == "x=-42");
+
+    CHECK(write_value(0.0) == "0.0");
+    CHECK(write_string("") == "\"\"");
+}
+
+TEST_CASE("json_writer: integers cover the full range") {
+    std::string out;
+    mx::json_writer w(out);
+    w.begin_array();
+    w.value(std::numeric_limits<long long>::min());
+    w.value(std::numeric_limits<long long>::max());
+    w.end_array();
+    const auto parsed = nl::json::parse(out);
+    CHECK(parsed[0].get<long long>() == std::numeric_limits<long long>::min());
+    CHECK(parsed[1].get<long long>() == std::numeric_limits<long long>::max());
+}
+
+TEST_CASE("json_writer: doubles stay floats and read back exactly") {
+    CHECK(write_value(2.0) == "2.0");
+    CHECK(write_value(-3.0) == "-3.0");
+    CHECK(write_value(0.1) == "0.1");
+    CHECK(write_value(1e300) == "1e+300");
+
+    for (double d : {0.1, 1.0 / 3.0, -2.5e-10, 6.02214076e23, 123456789.0,
+                     std::numeric_limits<double>::max(),
+                     std::numeric_limits<double>::denorm_min()}) {
+        const auto parsed = nl::json::parse(write_value(d));
+        CHECK(parsed.is_number_float());
+        CHECK(parsed.get<double>() == d);
+    }
+}
+
+TEST_CASE("json_writer: NaN and infinities are null") {
+    CHECK(write_value(std::numeric_limits<double>::quiet_NaN()) == "null");
+    CHECK(write_value(std::numeric_limits<double>::infinity()) == "null");
+    CHECK(write_value(-std::numeric_limits<double>::infinity()) == "null");
+}
+
+TEST_CASE("json_writer: strings are escaped as nl::json escapes them") {
+    for (const auto& text : {std::string("plain"), std::string("quote \" and \\ slash"),
+                             std::string("tab\tnew\nline\rfeed\f\b"),
+                             std::string("\x01\x1f nul:") + std::string(1, '\0'),
+                             std::string("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x8E\xB9")}) {
+        CHECK(write_string(text) == nl::json(text).dump());
+        CHECK(nl::json::parse(write_string(text)).get<std::string>() == text);
+    }
+}
+
+TEST_CASE("json_writer: invalid UTF-8 is replaced, never passed through") {
+    const std::string replacement = "\xEF\xBF\xBD";
+    CHECK(write_string("a\xFF" "b") == "\"a" + replacement + "b\"");
+    // Truncated sequence at the end.
+    CHECK(write_string("\xE2\x82") == "\"" + replacement + replacement + "\"");
+    // Overlong encoding of '/'.
+    CHECK(write_string("\xC0\xAF") == "\"" + replacement + replacement + "\"");
+    // UTF-16 surrogate half.
+    CHECK(write_string("\xED\xA0\x80") == "\"" + replacement + replacement + replacement + "\"");
+
+    // Whatever comes out, nl::json accepts it.
+    CHECK(nl::json::accept(write_string("\x80\xC3(\xF5\xF0\x9F")));
+}
@@ -0,0 +1,147 @@
+// Tests for lazily parsed messages (patch 0009): an incoming message keeps its
+// four JSON parts as received and parses each only when it is first read.
+
+#include "doctest.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace {
+
+// Frame order on the wire: identities, "<IDS|MSG>", signature, header,
+// parent_header, metadata, content.
+constexpr size_t k_signature = 2;
+
+zmq::multipart_t wire_of(const std::vector<std::string>& frames) {
+    zmq::multipart_t wire;
+    for (const std::string& f : frames) {
+        wire.add(zmq::message_t(f.data(), f.size()));
+    }
+    return wire;
+}
+
+// A kernel_info_request as a client would send it, signed with `auth`.
+std::vector<std::string> request_frames(const xeus::xauthentication& auth,
+                                        const std::string& content = "{}") {
+    std::vector<std::string> frames = {
+        "client", "<IDS|MSG>", "",
+        R"({"msg_id":"a1","msg_type":"kernel_info_request","session":"s","username":"u","date":"2026-10-17T12:00:00.000000Z","version":"5.3"})",
+        R"({"msg_id":"p0"})",
+        R"({"cellId":"c1"})",
+        content,
+    };
+    const auto raw = [](const std::string& s) {
+        return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+    };
+    frames[k_signature] = auth.sign(raw(frames[3]), raw(frames[4]), raw(frames[5]), raw(frames[6]));
+    return frames;
+}
+
+xeus::xmessage receive(const std::vector<std::string>& frames, const xeus::xauthentication& auth) {
+    zmq::multipart_t wire = wire_of(frames);
+    return xeus::xzmq_serializer::deserialize(wire, auth);
+}
+
+} // namespace
+
+TEST_CASE("a received message is parsed one part at a time") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    xeus::xmessage msg = receive(request_frames(*auth), *auth);
+
+    CHECK_FALSE(msg.header_part().is_parsed());
+    CHECK_FALSE(msg.parent_header_part().is_parsed());
+    CHECK_FALSE(msg.metadata_part().is_parsed());
+    CHECK_FALSE(msg.content_part().is_parsed());
+
+    CHECK(msg.header()["msg_type"] == "kernel_info_request");
+    CHECK(msg.header_part().is_parsed());
+    CHECK_FALSE(msg.parent_header_part().is_parsed());
+    CHECK_FALSE(msg.metadata_part().is_parsed());
+    CHECK_FALSE(msg.content_part().is_parsed());
+
+    CHECK(msg.metadata()["cellId"] == "c1");
+    CHECK(msg.parent_header()["msg_id"] == "p0");
+    CHECK(msg.content() == nl::json::object());
+}
+
+TEST_CASE("a received part keeps the bytes it arrived as") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    const auto frames = request_frames(*auth);
+    xeus::xmessage msg = receive(frames, *auth);
+
+    REQUIRE(msg.metadata_part().raw());
+    CHECK(*msg.metadata_part().raw() == frames[5]);
+    // Still there once parsed.
+    CHECK(msg.metadata()["cellId"] == "c1");
+    CHECK(*msg.metadata_part().raw() == frames[5]);
+}
+
+TEST_CASE("a shared header outlives the message it came from") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    std::shared_ptr<const nl::json> header;
+    {
+        xeus::xmessage msg = receive(request_frames(*auth), *auth);
+        header = msg.header_part().shared_value();
+        CHECK(header.get() == &msg.header());
+        xeus::xmessage moved = std::move(msg);
+    }
+    CHECK((*header)["msg_id"] == "a1");
+}
+
+TEST_CASE("copies of a part read from several threads share one parse") {
+    const xeus::xmessage_part part(std::make_shared<const std::string>(R"({"msg_id":"a1"})"));
+    std::vector<xeus::xmessage_part> copies(8, part);
+    std::vector<const nl::json*> seen(copies.size(), nullptr);
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < copies.size(); ++i) {
+        readers.emplace_back([&, i]() {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            seen[i] = &copies[i].value();
+        });
+    }
+    go.store(true);
+    for (std::thread& t : readers) {
+        t.join();
+    }
+
+    CHECK(part.is_parsed());
+    for (const nl::json* value : seen) {
+        CHECK(value == &part.value());
+    }
+    CHECK(part.value()["msg_id"] == "a1");
+}
+
+TEST_CASE("a part that is not JSON throws when read, not when received") {
+    // Correctly signed, so it gets past verification.
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    xeus::xmessage msg = receive(request_frames(*auth, "{not json"), *auth);
+
+    CHECK(msg.header()["msg_type"] == "kernel_info_request");
+    CHECK_THROWS_AS(msg.content(), nl::json::parse_error);
+}
+
+TEST_CASE("a message built from values is parsed from the start") {
+    xeus::xmessage msg({"client"}, xeus::make_header("status", "user", "session"),
+                       nl::json::object(), nl::json::object(),
+                       {{"execution_state", "idle"}}, {});
+    CHECK(msg.header_part().is_parsed());
+    CHECK_FALSE(msg.header_part().raw());
+    CHECK(msg.content()["execution_state"] == "idle");
+
+    const xeus::xmessage empty;
+    CHECK(empty.header().is_null());
+    CHECK(empty.header_part().shared_value()->is_null());
+}
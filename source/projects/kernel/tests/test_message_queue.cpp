@@ -1,6 +1,9 @@
 #include "doctest.h"
 #include "../message_queue.h"
 
+#include <string>
+#include <thread>
+
 TEST_CASE("ThreadSafeQueue basic operations") {
     mx::ThreadSafeQueue<int> q;
 
@@ -45,13 +48,35 @@ TEST_CASE("ThreadSafeQueue basic operations") {
     }
 }
 
+TEST_CASE("a bounded ThreadSafeQueue rejects and counts pushes past capacity") {
+    mx::ThreadSafeQueue<int> q(2);
+    CHECK(q.capacity() == 2);
+    CHECK(q.push(1));
+    CHECK(q.push(2));
+    CHECK_FALSE(q.push(3));
+    CHECK(q.size() == 2);
+    CHECK(q.dropped() == 1);
+
+    CHECK(q.try_pop().value() == 1);
+    CHECK(q.push(4));
+    CHECK(q.try_pop().value() == 2);
+    CHECK(q.try_pop().value() == 4);
+    CHECK(q.dropped() == 1);
+
+    mx::ThreadSafeQueue<int> unbounded;
+    for (int i = 0; i < 10000; ++i) {
+        CHECK(unbounded.push(i));
+    }
+    CHECK(unbounded.dropped() == 0);
+}
+
 TEST_CASE("ThreadSafeQueue with OutletMessage") {
     mx::ThreadSafeQueue<mx::OutletMessage> q;
 
     mx::OutletMessage msg;
-    msg.selector = "code";
-    msg.atoms.push_back(std::string("execute"));
-    msg.atoms.push_back(std::string("print(42)"));
+    msg.selector = mx::outlet_selector::code;
+    msg.add_symbol("execute");
+    msg.add_symbol("print(42)");
     msg.outlet_index = 0;
     msg.execution_counter = 1;
 
@@ -59,14 +84,65 @@ TEST_CASE("ThreadSafeQueue with OutletMessage") {
 
     auto result = q.try_pop();
     REQUIRE(result.has_value());
-    CHECK(result->selector == "code");
-    CHECK(result->atoms.size() == 2);
-    CHECK(std::get<std::string>(result->atoms[0]) == "execute");
-    CHECK(std::get<std::string>(result->atoms[1]) == "print(42)");
+    CHECK(result->selector == mx::outlet_selector::code);
+    CHECK(result->size() == 2);
+    CHECK(result->symbol(0) == "execute");
+    CHECK(result->symbol(1) == "print(42)");
     CHECK(result->outlet_index == 0);
     CHECK(result->execution_counter == 1);
 }
 
+TEST_CASE("OutletMessage keeps typed atoms in one flat buffer") {
+    mx::OutletMessage msg;
+    msg.add_symbol("cell");
+    msg.add_long(-3);
+    msg.add_double(0.25);
+    msg.add_symbol("");
+    msg.add_symbol("metro 100");
+
+    REQUIRE(msg.size() == 5);
+    CHECK(msg.tag(0) == mx::atom_tag::symbol);
+    CHECK(msg.tag(1) == mx::atom_tag::integer);
+    CHECK(msg.tag(2) == mx::atom_tag::real);
+    CHECK(msg.symbol(0) == "cell");
+    CHECK(msg.integer(1) == -3);
+    CHECK(msg.real(2) == 0.25);
+    CHECK(msg.symbol(3).empty());
+    CHECK(msg.symbol(4) == "metro 100");
+
+    // Each symbol is terminated in place, ready for gensym.
+    CHECK(std::string(msg.symbol_cstr(0)) == "cell");
+    CHECK(std::string(msg.symbol_cstr(3)).empty());
+    CHECK(std::string(msg.symbol_cstr(4)) == "metro 100");
+
+    SUBCASE("clear resets everything") {
+        msg.selector = mx::outlet_selector::shutdown;
+        msg.outlet_index = 1;
+        msg.execution_counter = 7;
+        msg.body_index = 4;
+        msg.clear();
+        CHECK(msg.empty());
+        CHECK(msg.selector == mx::outlet_selector::code);
+        CHECK(msg.outlet_index == 0);
+        CHECK(msg.execution_counter == 0);
+        CHECK(msg.body_index == -1);
+
+        msg.add_symbol("again");
+        CHECK(msg.symbol(0) == "again");
+    }
+
+    SUBCASE("survives a move") {
+        mx::OutletMessage moved(std::move(msg));
+        CHECK(moved.symbol(4) == "metro 100");
+        CHECK(moved.integer(1) == -3);
+    }
+}
+
+TEST_CASE("selector names") {
+    CHECK(std::string(mx::selector_name(mx::outlet_selector::code)) == "code");
+    CHECK(std::string(mx::selector_name(mx::outlet_selector::shutdown)) == "shutdown");
+}
+
 TEST_CASE("ResultMessage") {
     SUBCASE("normal result") {
         mx::ResultMessage r;
@@ -81,3 +157,120 @@ TEST_CASE("ResultMessage") {
         CHECK(r.is_error());
     }
 }
+
+TEST_CASE("SpscRing basic operations") {
+    mx::SpscRing<int> q(4);
+
+    SUBCASE("starts empty") {
+        CHECK(q.empty());
+        CHECK(q.size() == 0);
+        CHECK(!q.try_pop().has_value());
+    }
+
+    SUBCASE("FIFO ordering across wrap-around") {
+        for (int round = 0; round < 10; ++round) {
+            CHECK(q.push(round * 3));
+            CHECK(q.push(round * 3 + 1));
+            CHECK(q.push(round * 3 + 2));
+            CHECK(q.try_pop().value() == round * 3);
+            CHECK(q.try_pop().value() == round * 3 + 1);
+            CHECK(q.try_pop().value() == round * 3 + 2);
+        }
+        CHECK(q.empty());
+    }
+
+    SUBCASE("clear empties the ring") {
+        q.push(1);
+        q.push(2);
+        q.clear();
+        CHECK(q.empty());
+        CHECK(q.push(3));
+        CHECK(q.try_pop().value() == 3);
+    }
+}
+
+TEST_CASE("SpscRing capacity rounds up to a power of two") {
+    CHECK(mx::SpscRing<int>(0).capacity() == 2);
+    CHECK(mx::SpscRing<int>(3).capacity() == 4);
+    CHECK(mx::SpscRing<int>(1024).capacity() == 1024);
+    CHECK(mx::SpscRing<int>(1025).capacity() == 2048);
+}
+
+TEST_CASE("SpscRing rejects a push when full and leaves the item with the caller") {
+    mx::SpscRing<std::string> q(2);
+    CHECK(q.push(std::string("a")));
+    CHECK(q.push(std::string("b")));
+
+    std::string extra = "c";
+    CHECK(!q.push(std::move(extra)));
+    CHECK(extra == "c");
+    CHECK(q.dropped() == 1);
+    CHECK(q.size() == 2);
+
+    // Popping makes room again, and what was queued is untouched.
+    CHECK(q.try_pop().value() == "a");
+    CHECK(q.push(std::move(extra)));
+    CHECK(q.try_pop().value() == "b");
+    CHECK(q.try_pop().value() == "c");
+    CHECK(q.dropped() == 1);
+}
+
+TEST_CASE("SpscRing hands every item across threads in order") {
+    constexpr long k_items = 200000;
+    mx::SpscRing<long> q(64); // small, so both full and empty are hit often
+
+    std::thread producer([&q] {
+        for (long i = 0; i < k_items;) {
+            if (q.push(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    long expected = 0;
+    bool in_order = true;
+    while (expected < k_items) {
+        if (auto v = q.try_pop()) {
+            in_order = in_order && (*v == expected);
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    CHECK(in_order);
+    CHECK(q.empty());
+}
+
+TEST_CASE("drain_into moves the whole backlog, in order, and appends") {
+    std::vector<int> out{-1};
+
+    SUBCASE("ThreadSafeQueue") {
+        mx::ThreadSafeQueue<int> q;
+        CHECK(q.drain_into(out) == 0);
+        for (int i = 0; i < 5; ++i) q.push(i);
+        CHECK(q.drain_into(out) == 5);
+        CHECK(q.empty());
+    }
+
+    SUBCASE("SpscRing, across wrap-around") {
+        mx::SpscRing<int> q(4);
+        q.push(100);
+        q.push(101);
+        q.try_pop();
+        q.try_pop();
+        CHECK(q.drain_into(out) == 0);
+        for (int i = 0; i < 4; ++i) CHECK(q.push(i));
+        q.try_pop();
+        CHECK(q.push(4));
+        out.push_back(0); // stands in for the item popped above
+        CHECK(q.drain_into(out) == 4);
+        CHECK(q.empty());
+        CHECK(q.push(5)); // the drained slots are free again
+    }
+
+    CHECK(out == std::vector<int>{-1, 0, 1, 2, 3, 4});
+}
@@ -0,0 +1,118 @@
+// Tests for OutletDrain -- the budget that keeps a backlog of outlet messages
+// from holding up Max's main thread. The clock and the sink standing in for
+// outlet_anything are both fakes, so budgets are exact.
+
+#include "doctest.h"
+
+#include "../message_queue.h"
+#include "../outlet_drain.h"
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// A clock that only moves when a delivery says so.
+struct fake_clock {
+    mx::OutletDrain::clock::time_point t{};
+    mx::OutletDrain::clock::time_point operator()() const { return t; }
+};
+
+// Records what was delivered, and charges each delivery to the clock.
+struct fake_sink {
+    fake_clock& clock;
+    std::chrono::microseconds cost;
+    std::vector<int> delivered;
+
+    void operator()(const mx::OutletMessage& m) {
+        delivered.push_back(m.execution_counter);
+        clock.t += cost;
+    }
+};
+
+void fill(mx::SpscRing<mx::OutletMessage>& q, int from, int count) {
+    for (int i = from; i < from + count; ++i) {
+        mx::OutletMessage msg;
+        msg.execution_counter = i;
+        q.push(std::move(msg));
+    }
+}
+
+} // namespace
+
+TEST_CASE("a backlog within budget is delivered in one call") {
+    mx::SpscRing<mx::OutletMessage> q(64);
+    mx::OutletDrain drain({10, 1000us});
+    fake_clock clock;
+    fake_sink sink{clock, 1us, {}};
+
+    fill(q, 0, 5);
+    CHECK(!drain.run(q, sink, clock));
+    CHECK(sink.delivered == std::vector<int>{0, 1, 2, 3, 4});
+    CHECK(drain.held() == 0);
+
+    // Nothing queued: nothing delivered, nothing to come back for.
+    CHECK(!drain.run(q, sink, clock));
+    CHECK(sink.delivered.size() == 5);
+}
+
+TEST_CASE("the message budget splits a backlog across calls, in order") {
+    mx::SpscRing<mx::OutletMessage> q(64);
+    mx::OutletDrain drain({4, 1000000us});
+    fake_clock clock;
+    fake_sink sink{clock, 1us, {}};
+
+    fill(q, 0, 10);
+    CHECK(drain.run(q, sink, clock));
+    CHECK(sink.delivered.size() == 4);
+    CHECK(drain.held() == 6);
+
+    // Messages queued meanwhile go after the ones already held.
+    fill(q, 10, 2);
+    CHECK(drain.run(q, sink, clock));
+    CHECK(!drain.run(q, sink, clock)); // the last four, exactly
+
+    std::vector<int> expected;
+    for (int i = 0; i < 12; ++i) expected.push_back(i);
+    CHECK(sink.delivered == expected);
+}
+
+TEST_CASE("the time budget stops a call once it is spent") {
+    mx::SpscRing<mx::OutletMessage> q(64);
+    mx::OutletDrain drain({1000, 1000us});
+    fake_clock clock;
+    fake_sink sink{clock, 300us, {}};
+
+    fill(q, 0, 10);
+    CHECK(drain.run(q, sink, clock));
+    // 300, 600, 900: still within budget. 1200: over, so stop.
+    CHECK(sink.delivered.size() == 4);
+}
+
+TEST_CASE("a message that alone exceeds the budget is still delivered") {
+    mx::SpscRing<mx::OutletMessage> q(64);
+    mx::OutletDrain drain({1000, 100us});
+    fake_clock clock;
+    fake_sink sink{clock, 5000us, {}};
+
+    fill(q, 0, 3);
+    for (int call = 1; call <= 3; ++call) {
+        drain.run(q, sink, clock);
+        CHECK(sink.delivered.size() == static_cast<size_t>(call));
+    }
+    CHECK(!drain.run(q, sink, clock));
+}
+
+TEST_CASE("the default clock and budget drain a small backlog in one call") {
+    mx::SpscRing<mx::OutletMessage> q(64);
+    mx::OutletDrain drain;
+    std::vector<int> delivered;
+
+    fill(q, 0, 8);
+    CHECK(!drain.run(q, [&](const mx::OutletMessage& m) {
+        delivered.push_back(m.execution_counter);
+    }));
+    CHECK(delivered.size() == 8);
+}
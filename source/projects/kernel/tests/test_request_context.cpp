@@ -0,0 +1,108 @@
+// Tests for the shared parent header (patch 0012): a request context writes
+// its header as text at most once, every copy shares that text, and the
+// serializer sends it as the parent_header of whatever is published under
+// the context.
+
+#include "doctest.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+#include "xeus/xrequest_context.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace {
+
+nl::json request_header() {
+    return nl::json{{"msg_id", "req-1"}, {"msg_type", "execute_request"}, {"session", "s"},
+                    {"username", "u"}, {"date", "2026-10-17T12:00:00.000000Z"},
+                    {"version", "5.3"}};
+}
+
+// An IOPub message published under `context`, as xkernel_core builds one.
+xeus::xpub_message published_under(const xeus::xrequest_context& context, int line) {
+    xeus::xmessage_raw_data data;
+    data.m_header = xeus::make_header_part("stream", "kernel", "session-1");
+    data.m_parent_header = context.header_part();
+    data.m_metadata = nl::json::object();
+    data.m_content = nl::json{{"name", "stdout"}, {"text", std::to_string(line) + "\n"}};
+    return xeus::xpub_message("kernel_core.k.stream", std::move(data));
+}
+
+} // namespace
+
+TEST_CASE("a context's header is written once and shared by its copies") {
+    const xeus::xrequest_context context(request_header(), {"client"});
+    CHECK(context.header()["msg_id"] == "req-1");
+
+    const xeus::xmessage_part& part = context.header_part();
+    REQUIRE(part.raw());
+    CHECK(*part.raw() == request_header().dump());
+    CHECK(&part.value() == &context.header());
+
+    const xeus::xrequest_context copy = context;
+    CHECK(copy.header_part().raw() == part.raw());
+    CHECK(&copy.header() == &context.header());
+    CHECK(copy.id() == xeus::xrequest_context::guid_list{"client"});
+}
+
+TEST_CASE("a context for a received header keeps the bytes it arrived as") {
+    const std::string text = R"({ "msg_id": "req-2", "msg_type": "execute_request" })";
+    const xeus::xrequest_context context(xeus::xmessage_part(std::make_shared<const std::string>(text)),
+                                         {});
+    CHECK(context.header()["msg_id"] == "req-2");
+    REQUIRE(context.header_part().raw());
+    CHECK(*context.header_part().raw() == text);
+}
+
+TEST_CASE("a default or moved-from context has an empty header") {
+    const xeus::xrequest_context context;
+    CHECK(context.header() == nl::json::object());
+    CHECK(*context.header_part().raw() == "{}");
+
+    xeus::xrequest_context from(request_header(), {});
+    const xeus::xrequest_context to = std::move(from);
+    CHECK(to.header()["msg_id"] == "req-1");
+    CHECK(from.header() == nl::json::object());
+    CHECK(*from.header_part().raw() == "{}");
+}
+
+TEST_CASE("threads asking for the text at once all get the same text") {
+    const xeus::xrequest_context context(request_header(), {});
+    constexpr int k_threads = 4;
+    std::vector<const std::string*> seen(k_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < k_threads; ++t) {
+        threads.emplace_back([&, t] {
+            const xeus::xrequest_context copy = context;
+            seen[t] = copy.header_part().raw().get();
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    for (const std::string* text : seen) {
+        CHECK(text == context.header_part().raw().get());
+    }
+}
+
+TEST_CASE("every message published under a context carries its header text") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    const xeus::xrequest_context context(request_header(), {});
+    const std::string text = *context.header_part().raw();
+
+    for (int line = 0; line < 3; ++line) {
+        zmq::multipart_t wire =
+            xeus::xzmq_serializer::serialize_iopub(published_under(context, line), *auth);
+        xeus::xpub_message received = xeus::xzmq_serializer::deserialize_iopub(wire, *auth);
+        REQUIRE(received.parent_header_part().raw());
+        CHECK(*received.parent_header_part().raw() == text);
+        CHECK(received.content()["text"] == std::to_string(line) + "\n");
+    }
+}
@@ -1,4 +1,5 @@
-// Integration tests for the timed-poll patch against xeus-zmq.
+// Integration tests for the timed-poll, wake-up and verify-before-parse
+// patches against xeus-zmq, and for the status fast path in xeus.
 //
 // These start a real xkernel with a real ZMQ server bound to loopback, so they
 // exercise the exact shutdown path that used to hang Max. No Max SDK involved.
@@ -14,6 +15,7 @@
 #include "../connection.h"
 #include "../types.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdio>
@@ -21,6 +23,7 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "xeus/xkernel.hpp"
 #include "xeus/xkernel_configuration.hpp"
@@ -28,6 +31,9 @@
 #include "xeus/xsystem.hpp"
 #include "xeus-zmq/xserver_zmq.hpp"
 #include "xeus-zmq/xzmq_context.hpp"
+#include "xauthentication.hpp"
+#include "zmq.hpp"
+#include "zmq_addon.hpp"
 
 using namespace std::chrono_literals;
 
@@ -257,3 +263,199 @@ TEST_CASE("a negative poll timeout restores blocking behaviour") {
     rk.kernel->stop();
     rk.thread.join();
 }
+
+TEST_CASE("stop() wakes a loop parked on a long poll timeout") {
+    watchdog guard(30s, "stop with a long poll timeout");
+
+    running_kernel rk;
+    auto* server = dynamic_cast<xeus::xserver_zmq*>(&rk.kernel->get_server());
+    REQUIRE(server != nullptr);
+    server->set_poll_timeout(10000);
+
+    rk.start();
+    server->wake(); // one tick, so wait_until_serving sees the loop running
+    REQUIRE(rk.wait_until_serving());
+
+    // Without the wake-up in stop_impl this would take up to the full 10s.
+    const auto start = std::chrono::steady_clock::now();
+    rk.kernel->stop();
+    rk.thread.join();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(elapsed < 1s);
+}
+
+TEST_CASE("output pushed from Max is handled on a wake-up, not at the poll timeout") {
+    watchdog guard(60s, "wake-up latency");
+
+    running_kernel rk;
+    auto* server = dynamic_cast<xeus::xserver_zmq*>(&rk.kernel->get_server());
+    REQUIRE(server != nullptr);
+
+    // Long enough that a round trip served by the timeout could not possibly
+    // pass the checks below.
+    server->set_poll_timeout(2000);
+
+    std::atomic<int> flushed{0};
+    server->set_idle_callback([&rk, &flushed] {
+        rk.idle_ticks.fetch_add(1);
+        while (auto out = rk.impl.async_queue.try_pop()) {
+            flushed.fetch_add(1);
+        }
+    });
+    rk.impl.set_server_waker([server] { server->wake(); });
+
+    rk.start();
+    rk.impl.wake_server();
+    REQUIRE(rk.wait_until_serving());
+
+    // Push the way `print` does and time the turnaround to the server thread.
+    constexpr int rounds = 200;
+    std::vector<std::chrono::nanoseconds> samples;
+    samples.reserve(rounds);
+
+    for (int i = 0; i < rounds; ++i) {
+        const int before = flushed.load();
+        const auto start = std::chrono::steady_clock::now();
+
+        mx::ResultMessage note;
+        note.stream_name = "stdout";
+        note.text = "ping";
+        rk.impl.async_queue.push(std::move(note));
+        rk.impl.wake_server();
+
+        while (flushed.load() == before) {
+            std::this_thread::yield();
+        }
+        samples.push_back(std::chrono::steady_clock::now() - start);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto median = samples[rounds / 2];
+    const auto worst = samples.back();
+
+    MESSAGE("wake-up turnaround: median "
+            << std::chrono::duration_cast<std::chrono::microseconds>(median).count()
+            << "us, worst "
+            << std::chrono::duration_cast<std::chrono::microseconds>(worst).count()
+            << "us over " << rounds << " rounds");
+
+    CHECK(median < 1ms);
+    // Not one round was left waiting for the poll to time out.
+    CHECK(worst < 1s);
+
+    rk.impl.clear_server_waker();
+    rk.kernel->stop();
+    rk.thread.join();
+}
+
+TEST_CASE("a forged message on shell is counted and dropped") {
+    watchdog guard(30s, "forged message");
+
+    running_kernel rk;
+    auto* server = dynamic_cast<xeus::xserver_zmq*>(&rk.kernel->get_server());
+    REQUIRE(server != nullptr);
+    rk.start();
+    REQUIRE(rk.wait_until_serving());
+
+    zmq::context_t context;
+    zmq::socket_t dealer(context, zmq::socket_type::dealer);
+    dealer.set(zmq::sockopt::linger, 0);
+    dealer.connect("tcp://127.0.0.1:" + rk.kernel->get_config().m_shell_port);
+
+    // Not even JSON: rejected on its signature, it never reaches the parser.
+    zmq::multipart_t forged;
+    for (const char* frame : {"<IDS|MSG>", "0000", "{not json", "{}", "{}", "{}"}) {
+        forged.addstr(frame);
+    }
+    forged.send(dealer);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (server->rejected_messages() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(5ms);
+    }
+    CHECK(server->rejected_messages() == 1);
+
+    // The loop carries on serving.
+    const int before = rk.idle_ticks.load();
+    std::this_thread::sleep_for(100ms);
+    CHECK(rk.idle_ticks.load() > before);
+
+    rk.kernel->stop();
+    rk.thread.join();
+}
+
+TEST_CASE("busy and idle statuses carry the request's header as it was sent") {
+    watchdog guard(30s, "status round trip");
+
+    running_kernel rk;
+    rk.start();
+    REQUIRE(rk.wait_until_serving());
+
+    const xeus::xconfiguration& config = rk.kernel->get_config();
+    const auto auth = xeus::make_xauthentication(config.m_signature_scheme, config.m_key);
+
+    zmq::context_t context;
+    zmq::socket_t iopub(context, zmq::socket_type::sub);
+    iopub.set(zmq::sockopt::linger, 0);
+    iopub.set(zmq::sockopt::rcvtimeo, 5000);
+    iopub.set(zmq::sockopt::subscribe, "");
+    iopub.connect("tcp://127.0.0.1:" + config.m_iopub_port);
+    zmq::socket_t dealer(context, zmq::socket_type::dealer);
+    dealer.set(zmq::sockopt::linger, 0);
+    dealer.connect("tcp://127.0.0.1:" + config.m_shell_port);
+
+    // IOPub frames: topic, "<IDS|MSG>", signature, header, parent_header,
+    // metadata, content.
+    const auto receive = [&iopub] {
+        zmq::multipart_t wire;
+        std::vector<std::string> frames;
+        if (wire.recv(iopub)) {
+            while (!wire.empty()) {
+                frames.push_back(wire.popstr());
+            }
+        }
+        return frames;
+    };
+
+    // The welcome message says the subscription is live, so nothing after it
+    // is lost to a slow join.
+    std::vector<std::string> frames = receive();
+    REQUIRE(frames.size() == 7);
+    REQUIRE(nlohmann::json::parse(frames[3])["msg_type"] == "iopub_welcome");
+
+    // Unusual spacing and key order, which a parse and dump would not keep.
+    const std::string header =
+        R"({ "msg_type": "kernel_info_request", "msg_id": "req-1", "session": "s",)"
+        R"( "username": "u", "date": "2026-10-17T12:00:00.000000Z", "version": "5.3" })";
+    const auto raw = [](const std::string& s) {
+        return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+    };
+    zmq::multipart_t request;
+    request.addstr("<IDS|MSG>");
+    request.addstr(auth->sign(raw(header), raw("{}"), raw("{}"), raw("{}")));
+    request.addstr(header);
+    request.addstr("{}");
+    request.addstr("{}");
+    request.addstr("{}");
+    request.send(dealer);
+
+    std::vector<std::string> states;
+    while (states.size() < 2) {
+        frames = receive();
+        REQUIRE(frames.size() == 7);
+        const auto message_header = nlohmann::json::parse(frames[3]);
+        if (message_header["msg_type"] != "status") {
+            continue;
+        }
+        CHECK(frames[4] == header);
+        CHECK(auth->verify(raw(frames[2]), raw(frames[3]), raw(frames[4]), raw(frames[5]),
+                           raw(frames[6])));
+        CHECK(frames[5] == "{}");
+        states.push_back(nlohmann::json::parse(frames[6])["execution_state"]);
+    }
+    CHECK(states == std::vector<std::string>{"busy", "idle"});
+
+    rk.kernel->stop();
+    rk.thread.join();
+}
@@ -0,0 +1,152 @@
+// Tests for message signing in xeus-zmq: the verify-before-parse patch (0007),
+// under which a message whose signature does not match is rejected on its raw
+// frames before any of them reaches the JSON parser, and the pooled HMAC
+// contexts (0008), which must sign exactly as before from any number of
+// threads.
+
+#include "doctest.h"
+
+#include "xzmq_serializer.hpp"
+
+#include "xeus/xmessage.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace {
+
+// Frame order on the wire: identities, "<IDS|MSG>", signature, header,
+// parent_header, metadata, content, then any buffers.
+constexpr size_t k_signature = 2;
+constexpr size_t k_header = 3;
+constexpr size_t k_content = 6;
+
+std::vector<std::string> frames_of(zmq::multipart_t& wire) {
+    std::vector<std::string> frames;
+    while (!wire.empty()) {
+        zmq::message_t m = wire.pop();
+        frames.emplace_back(m.data<const char>(), m.size());
+    }
+    return frames;
+}
+
+zmq::multipart_t wire_of(const std::vector<std::string>& frames) {
+    zmq::multipart_t wire;
+    for (const std::string& f : frames) {
+        wire.add(zmq::message_t(f.data(), f.size()));
+    }
+    return wire;
+}
+
+xeus::xraw_buffer raw(const std::string& s) {
+    return xeus::xraw_buffer(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+// RFC 4231-style check: HMAC-SHA256("key", "The quick brown fox jumps over the
+// lazy dog"), with the message split across the four signed parts.
+const std::string k_fox[4] = {"The quick ", "brown fox ", "jumps over ", "the lazy dog"};
+constexpr const char* k_fox_hmac =
+    "f7bc83f430538424b13298e6aa6fb143ef4d59a14946175997479dbc2d1a3cd8";
+
+std::string sign_fox(const xeus::xauthentication& auth) {
+    return auth.sign(raw(k_fox[0]), raw(k_fox[1]), raw(k_fox[2]), raw(k_fox[3]));
+}
+
+std::vector<std::string> signed_frames(const xeus::xauthentication& auth) {
+    xeus::xmessage msg({"client"}, xeus::make_header("execute_request", "user", "session"),
+                       nl::json::object(), nl::json::object(),
+                       {{"code", "metro 100"}}, {});
+    zmq::multipart_t wire = xeus::xzmq_serializer::serialize(std::move(msg), auth);
+    return frames_of(wire);
+}
+
+} // namespace
+
+TEST_CASE("a correctly signed message is accepted") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    zmq::multipart_t wire = wire_of(signed_frames(*auth));
+
+    xeus::xmessage msg = xeus::xzmq_serializer::deserialize(wire, *auth);
+    CHECK(msg.content()["code"] == "metro 100");
+    CHECK(msg.identities() == std::vector<std::string>{"client"});
+}
+
+TEST_CASE("a tampered message is rejected") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    auto frames = signed_frames(*auth);
+    frames[k_content] = R"({"code":"quit"})";
+    zmq::multipart_t wire = wire_of(frames);
+
+    CHECK_THROWS_AS(xeus::xzmq_serializer::deserialize(wire, *auth), xeus::xsignature_error);
+}
+
+TEST_CASE("a bad signature is rejected without invoking the parser") {
+    // Frames that are not JSON at all: parsing them first would throw
+    // nl::json::parse_error instead.
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    auto frames = signed_frames(*auth);
+    frames[k_signature] = std::string(64, '0');
+    frames[k_header] = "{not json";
+    frames[k_content] = "\x01\x02\x03";
+    zmq::multipart_t wire = wire_of(frames);
+
+    CHECK_THROWS_AS(xeus::xzmq_serializer::deserialize(wire, *auth), xeus::xsignature_error);
+}
+
+TEST_CASE("a signature of the wrong length is rejected") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "secret");
+    for (const auto& sig : {std::string(), std::string("ab"), std::string(200, 'a')}) {
+        auto frames = signed_frames(*auth);
+        frames[k_signature] = sig;
+        zmq::multipart_t wire = wire_of(frames);
+        CHECK_THROWS_AS(xeus::xzmq_serializer::deserialize(wire, *auth), xeus::xsignature_error);
+    }
+
+    // A correct signature with trailing bytes is not a match either.
+    auto frames = signed_frames(*auth);
+    frames[k_signature] += "00";
+    zmq::multipart_t wire = wire_of(frames);
+    CHECK_THROWS_AS(xeus::xzmq_serializer::deserialize(wire, *auth), xeus::xsignature_error);
+}
+
+TEST_CASE("signing matches HMAC-SHA256, call after call") {
+    // Every call after the first reuses a pooled context, reset but not
+    // re-keyed; it must start from the key, not from the last message.
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "key");
+    for (int i = 0; i < 3; ++i) {
+        CHECK(sign_fox(*auth) == k_fox_hmac);
+    }
+    const std::string other = "other";
+    CHECK(auth->sign(raw(other), raw(other), raw(other), raw(other)) != k_fox_hmac);
+    CHECK(sign_fox(*auth) == k_fox_hmac);
+
+    const std::string sig = k_fox_hmac;
+    CHECK(auth->verify(raw(sig), raw(k_fox[0]), raw(k_fox[1]), raw(k_fox[2]), raw(k_fox[3])));
+}
+
+TEST_CASE("signing from several threads at once") {
+    const auto auth = xeus::make_xauthentication("hmac-sha256", "key");
+    constexpr int k_threads = 4;
+    constexpr int k_signs = 500;
+    std::vector<int> mismatches(k_threads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < k_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < k_signs; ++i) {
+                if (sign_fox(*auth) != k_fox_hmac) {
+                    ++mismatches[t];
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    for (int t = 0; t < k_threads; ++t) {
+        CHECK(mismatches[t] == 0);
+    }
+}
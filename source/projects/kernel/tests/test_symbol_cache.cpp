@@ -0,0 +1,135 @@
+// Tests for symbol_cache -- the outlet drain's shortcut past gensym. A fake
+// symbol table records every intern, so a test can see which lookups reached
+// it.
+
+#include "doctest.h"
+
+#include "../symbol_cache.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct fake_symbol {
+    std::string name;
+};
+
+// Interns like gensym -- one symbol per distinct string, for good -- and
+// records each call.
+struct fake_table {
+    std::map<std::string, std::unique_ptr<fake_symbol>> symbols;
+    std::vector<std::string> calls;
+
+    fake_symbol* intern(const char* text) {
+        calls.emplace_back(text);
+        auto& slot = symbols[text];
+        if (!slot) {
+            slot = std::make_unique<fake_symbol>(fake_symbol{text});
+        }
+        return slot.get();
+    }
+};
+
+using cache_t = mx::symbol_cache<fake_symbol>;
+
+cache_t make_cache(fake_table& table) {
+    return cache_t([&table](const char* text) { return table.intern(text); });
+}
+
+} // namespace
+
+TEST_CASE("symbol_cache: a selector is interned once") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    fake_symbol* code = cache.selector(mx::outlet_selector::code);
+    REQUIRE(code != nullptr);
+    CHECK(code->name == "code");
+    CHECK(cache.selector(mx::outlet_selector::code) == code);
+    CHECK(cache.selector(mx::outlet_selector::code) == code);
+
+    CHECK(cache.selector(mx::outlet_selector::shutdown)->name == "shutdown");
+    CHECK(table.calls == std::vector<std::string>{"code", "shutdown"});
+}
+
+TEST_CASE("symbol_cache: short text is interned once and then hit") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    fake_symbol* execute = cache.lookup("execute");
+    CHECK(execute->name == "execute");
+    for (int i = 0; i < 10; ++i) {
+        CHECK(cache.lookup("execute") == execute);
+    }
+
+    CHECK(table.calls.size() == 1);
+    CHECK(cache.misses() == 1);
+    CHECK(cache.hits() == 10);
+}
+
+TEST_CASE("symbol_cache: text is compared, not just slotted") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    // Same length, same first, middle and last characters: same slot.
+    fake_symbol* a = cache.lookup("abxba");
+    fake_symbol* b = cache.lookup("abxca");
+    CHECK(a->name == "abxba");
+    CHECK(b->name == "abxca");
+
+    // Each evicted the other, so both go back to the table.
+    CHECK(cache.lookup("abxba") == a);
+    CHECK(cache.lookup("abxca") == b);
+    CHECK(table.calls.size() == 4);
+    CHECK(cache.hits() == 0);
+}
+
+TEST_CASE("symbol_cache: a prefix of a cached word is a different symbol") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    fake_symbol* metro = cache.lookup("metro");
+    CHECK(cache.lookup("metr") != metro);
+    CHECK(cache.lookup("metro") == metro);
+    CHECK(cache.lookup("") != nullptr);
+    CHECK(cache.lookup("")->name.empty());
+}
+
+TEST_CASE("symbol_cache: long text always goes to the table") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    const std::string cell(cache_t::k_max_length + 1, 'x');
+    fake_symbol* first = cache.lookup(cell);
+    fake_symbol* second = cache.lookup(cell);
+
+    // gensym gives the same symbol back, but the cache never held it.
+    CHECK(first == second);
+    CHECK(table.calls.size() == 2);
+    CHECK(cache.hits() == 0);
+
+    const std::string longest(cache_t::k_max_length, 'y');
+    cache.lookup(longest);
+    cache.lookup(longest);
+    CHECK(table.calls.size() == 3);
+    CHECK(cache.hits() == 1);
+}
+
+TEST_CASE("symbol_cache: symbols from an OutletMessage") {
+    fake_table table;
+    auto cache = make_cache(table);
+
+    mx::OutletMessage m;
+    m.add_symbol("execute");
+    m.add_symbol("metro");
+    m.add_long(100);
+
+    for (int run = 0; run < 3; ++run) {
+        CHECK(cache.lookup(m.symbol(0))->name == "execute");
+        CHECK(cache.lookup(m.symbol(1))->name == "metro");
+    }
+    CHECK(table.calls == std::vector<std::string>{"execute", "metro"});
+}
@@ -0,0 +1,74 @@
+// Tests for typed_array -- the packing behind `result array`.
+
+#include "doctest.h"
+
+#include "../typed_array.h"
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+TEST_CASE("typed_array: integers pack as int64") {
+    mx::typed_array a;
+    CHECK(a.empty());
+    a.add(1LL);
+    a.add(-2LL);
+    a.add(std::numeric_limits<long long>::max());
+
+    CHECK(a.dtype() == mx::array_dtype::int64);
+    CHECK(a.count() == 3);
+    CHECK(a.bytes().size() == 3 * 8);
+    CHECK(a.integer(0) == 1);
+    CHECK(a.integer(1) == -2);
+    CHECK(a.integer(2) == std::numeric_limits<long long>::max());
+    CHECK(a.shape() == std::vector<size_t>{3});
+}
+
+TEST_CASE("typed_array: one double turns the whole array float64") {
+    mx::typed_array a;
+    a.add(1LL);
+    a.add(2LL);
+    a.add(0.5);
+    a.add(3LL);
+
+    CHECK(a.dtype() == mx::array_dtype::float64);
+    CHECK(a.count() == 4);
+    CHECK(a.real(0) == 1.0);
+    CHECK(a.real(1) == 2.0);
+    CHECK(a.real(2) == 0.5);
+    CHECK(a.real(3) == 3.0);
+}
+
+TEST_CASE("typed_array: bytes are the values back to back, native order") {
+    mx::typed_array a;
+    a.add(0.25);
+    a.add(-1e300);
+
+    double expected[2] = {0.25, -1e300};
+    REQUIRE(a.bytes().size() == sizeof(expected));
+    CHECK(std::memcmp(a.bytes().data(), expected, sizeof(expected)) == 0);
+
+    const auto bytes = a.take_bytes();
+    CHECK(bytes.size() == sizeof(expected));
+    CHECK(a.empty());
+}
+
+TEST_CASE("typed_array: shape and description") {
+    mx::typed_array a;
+    for (long long i = 0; i < 6; ++i) {
+        a.add(i);
+    }
+    CHECK(mx::describe(a) == "array(int64, shape=[6])");
+
+    a.set_shape({2, 3});
+    CHECK(a.shape() == std::vector<size_t>{2, 3});
+    CHECK(mx::describe(a) == "array(int64, shape=[2, 3])");
+
+    CHECK(mx::describe(mx::typed_array{}) == "array(int64, shape=[0])");
+}
+
+TEST_CASE("typed_array: byte order is reported") {
+    const std::string order = mx::host_byte_order();
+    CHECK((order == "little" || order == "big"));
+}
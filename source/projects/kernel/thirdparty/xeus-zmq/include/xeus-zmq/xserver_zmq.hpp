@@ -51,6 +51,21 @@ namespace xeus
         void set_poll_timeout(long timeout_ms);
         long get_poll_timeout() const;
 
+        // LOCAL PATCH (mx-kernel) -- wake the server loop from another
+        // thread. See patches/README.md.
+        //
+        // Makes the loop's current (or next) poll return at once and run the
+        // idle callback, so work queued for the server thread is picked up
+        // without waiting out the poll timeout. Safe to call from any thread
+        // once the server is constructed; wake-ups that arrive before the loop
+        // has serviced the previous one are coalesced into it.
+        void wake();
+
+        // LOCAL PATCH (mx-kernel) -- messages on shell or control dropped
+        // because their signature did not match. They are rejected before
+        // any JSON is parsed. Safe to call from any thread.
+        std::size_t rejected_messages() const;
+
     protected:
 
         // Invoked by inheriting classes when a poll times out with no message.
@@ -69,7 +69,30 @@ namespace xeus
                          const xraw_buffer& meta_data,
                          const xraw_buffer& content) const override;
 
-        std::string compute_hex_signature(const xraw_buffer& header,
+        // LOCAL PATCH (mx-kernel) -- a pool of keyed MAC contexts rather
+        // than one context behind a mutex. See patches/README.md.
+        //
+        // Every sign and verify used to hold m_mac_mutex for the whole HMAC,
+        // so the server thread and the publisher thread signed one message
+        // at a time between them. Now each call takes a context of its own
+        // from the pool -- duplicating the keyed template when none is free
+        // -- and gives it back afterwards: the mutex is held for the take
+        // and the return only. The pool holds at most one context per thread
+        // that has signed concurrently. The key is set once, on the
+        // template; each message only resets its context.
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+        using mac_context = HMAC_CTX;
+#else
+        using mac_context = EVP_MAC_CTX;
+#endif
+
+        mac_context* acquire_context() const;
+        void release_context(mac_context* ctx) const;
+        mac_context* duplicate_context() const;
+        static void free_context(mac_context* ctx);
+
+        std::string compute_hex_signature(mac_context* ctx,
+                                          const xraw_buffer& header,
                                           const xraw_buffer& parent_header,
                                           const xraw_buffer& meta_data,
                                           const xraw_buffer& content) const;
@@ -84,7 +107,8 @@ namespace xeus
         EVP_MAC* m_evp_mac;
         EVP_MAC_CTX* m_evp_mac_ctx;
 #endif
-        mutable std::mutex m_mac_mutex;
+        mutable std::mutex m_pool_mutex;
+        mutable std::vector<mac_context*> m_pool;
     };
 
     // Specialization of xauthentication without any signature checking.
@@ -194,18 +218,100 @@ namespace xeus
             throw std::runtime_error("Could not allocate evp_mac_ctx");
         }
 #endif
+
+        // LOCAL PATCH (mx-kernel) -- key the template once; every pooled
+        // context is a copy of it.
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+        HMAC_Init_ex(m_hmac, m_key.c_str(), static_cast<int>(m_key.size()), m_evp, nullptr);
+#else
+        if (!EVP_MAC_init(m_evp_mac_ctx, reinterpret_cast<const unsigned char*>(m_key.c_str()), m_key.size(), m_ossl_params))
+        {
+            EVP_MAC_CTX_free(m_evp_mac_ctx);
+            EVP_MAC_free(m_evp_mac);
+            throw std::runtime_error("Could not initialise evp_mac_ctx");
+        }
+#endif
     }
 
     openssl_xauthentication::~openssl_xauthentication()
+    {
+        for (mac_context* ctx : m_pool)
+        {
+            free_context(ctx);
+        }
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+        free_context(m_hmac);
+#else
+        EVP_MAC_CTX_free(m_evp_mac_ctx);
+        EVP_MAC_free(m_evp_mac);
+#endif
+    }
+
+    auto openssl_xauthentication::acquire_context() const -> mac_context*
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_pool_mutex);
+            if (!m_pool.empty())
+            {
+                mac_context* ctx = m_pool.back();
+                m_pool.pop_back();
+                return ctx;
+            }
+        }
+        return duplicate_context();
+    }
+
+    void openssl_xauthentication::release_context(mac_context* ctx) const
+    {
+        try
+        {
+            std::lock_guard<std::mutex> lock(m_pool_mutex);
+            m_pool.push_back(ctx);
+        }
+        catch (...)
+        {
+            free_context(ctx);
+        }
+    }
+
+    auto openssl_xauthentication::duplicate_context() const -> mac_context*
     {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
         // OpenSSL 1.0.x
-        HMAC_CTX_cleanup(m_hmac);
+        mac_context* ctx = new HMAC_CTX();
+        HMAC_CTX_init(ctx);
+        if (!HMAC_CTX_copy(ctx, m_hmac))
+        {
+            free_context(ctx);
+            ctx = nullptr;
+        }
 #elif OPENSSL_VERSION_NUMBER < 0x30000000L
-        HMAC_CTX_free(m_hmac);
+        mac_context* ctx = HMAC_CTX_new();
+        if (ctx && !HMAC_CTX_copy(ctx, m_hmac))
+        {
+            free_context(ctx);
+            ctx = nullptr;
+        }
 #else
-        EVP_MAC_CTX_free(m_evp_mac_ctx);
-        EVP_MAC_free(m_evp_mac);
+        mac_context* ctx = EVP_MAC_CTX_dup(m_evp_mac_ctx);
+#endif
+        if (!ctx)
+        {
+            throw std::runtime_error("Could not duplicate the MAC context");
+        }
+        return ctx;
+    }
+
+    void openssl_xauthentication::free_context(mac_context* ctx)
+    {
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        // OpenSSL 1.0.x
+        HMAC_CTX_cleanup(ctx);
+        delete ctx;
+#elif OPENSSL_VERSION_NUMBER < 0x30000000L
+        HMAC_CTX_free(ctx);
+#else
+        EVP_MAC_CTX_free(ctx);
 #endif
     }
 
@@ -214,8 +320,18 @@ namespace xeus
                                                    const xraw_buffer& meta_data,
                                                    const xraw_buffer& content) const
     {
-        std::lock_guard<std::mutex> lock(m_mac_mutex);
-        std::string hex_sig = compute_hex_signature(header, parent_header, meta_data, content);
+        mac_context* ctx = acquire_context();
+        std::string hex_sig;
+        try
+        {
+            hex_sig = compute_hex_signature(ctx, header, parent_header, meta_data, content);
+        }
+        catch (...)
+        {
+            release_context(ctx);
+            throw;
+        }
+        release_context(ctx);
         return hex_sig;
     }
 
@@ -225,40 +341,50 @@ namespace xeus
                                               const xraw_buffer& meta_data,
                                               const xraw_buffer& content) const
     {
-        std::lock_guard<std::mutex> lock(m_mac_mutex);
-        std::string hex_sig = compute_hex_signature(header, parent_header, meta_data, content);
+        std::string hex_sig = sign_impl(header, parent_header, meta_data, content);
+        // LOCAL PATCH (mx-kernel) -- CRYPTO_memcmp reads hex_sig.size() bytes
+        // of the signature, so a shorter one was read past its end. The
+        // length is not secret; the comparison of the bytes stays constant
+        // time.
+        if (signature.size() != hex_sig.size())
+        {
+            return false;
+        }
         auto cmp = CRYPTO_memcmp(reinterpret_cast<const void*>(hex_sig.c_str()), signature.data(), hex_sig.size());
         return cmp == 0;
     }
 
-    std::string openssl_xauthentication::compute_hex_signature(const xraw_buffer& header,
+    std::string openssl_xauthentication::compute_hex_signature(mac_context* ctx,
+                                                               const xraw_buffer& header,
                                                                const xraw_buffer& parent_header,
                                                                const xraw_buffer& meta_data,
                                                                const xraw_buffer& content) const
     {
+        // LOCAL PATCH (mx-kernel) -- a null key restarts the MAC with the
+        // key the context already holds, skipping the key schedule.
 #if OPENSSL_VERSION_NUMBER < 0x30000000L
-        HMAC_Init_ex(m_hmac, m_key.c_str(), m_key.size(), m_evp, nullptr);
+        HMAC_Init_ex(ctx, nullptr, 0, nullptr, nullptr);
 
-        HMAC_Update(m_hmac, header.data(), header.size());
-        HMAC_Update(m_hmac, parent_header.data(), parent_header.size());
-        HMAC_Update(m_hmac, meta_data.data(), meta_data.size());
-        HMAC_Update(m_hmac, content.data(), content.size());
+        HMAC_Update(ctx, header.data(), header.size());
+        HMAC_Update(ctx, parent_header.data(), parent_header.size());
+        HMAC_Update(ctx, meta_data.data(), meta_data.size());
+        HMAC_Update(ctx, content.data(), content.size());
 
         auto sig = std::vector<unsigned char>(EVP_MD_size(m_evp));
-        HMAC_Final(m_hmac, sig.data(), nullptr);
+        HMAC_Final(ctx, sig.data(), nullptr);
 #else
-        EVP_MAC_init(m_evp_mac_ctx, reinterpret_cast<const unsigned char*>(m_key.c_str()), m_key.size(), m_ossl_params);
+        EVP_MAC_init(ctx, nullptr, 0, nullptr);
 
-        EVP_MAC_update(m_evp_mac_ctx, header.data(), header.size());
-        EVP_MAC_update(m_evp_mac_ctx, parent_header.data(), parent_header.size());
-        EVP_MAC_update(m_evp_mac_ctx, meta_data.data(), meta_data.size());
-        EVP_MAC_update(m_evp_mac_ctx, content.data(), content.size());
+        EVP_MAC_update(ctx, header.data(), header.size());
+        EVP_MAC_update(ctx, parent_header.data(), parent_header.size());
+        EVP_MAC_update(ctx, meta_data.data(), meta_data.size());
+        EVP_MAC_update(ctx, content.data(), content.size());
 
         size_t final_size(0);
         // Computes the final size
-        EVP_MAC_final(m_evp_mac_ctx, nullptr, &final_size, size_t(0));
+        EVP_MAC_final(ctx, nullptr, &final_size, size_t(0));
         auto sig = std::vector<unsigned char>(final_size);
-        EVP_MAC_final(m_evp_mac_ctx, sig.data(), &final_size, sig.size());
+        EVP_MAC_final(ctx, sig.data(), &final_size, sig.size());
 #endif
         return hex_string(sig);
 
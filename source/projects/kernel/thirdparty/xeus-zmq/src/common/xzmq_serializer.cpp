@@ -7,6 +7,9 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <memory>
+#include <utility>
+
 #include "xzmq_serializer.hpp"
 
 namespace xeus
@@ -32,16 +35,72 @@ namespace xeus
             return xraw_buffer(msg.data<const unsigned char>(), msg.size());
         }
 
-        void parse_zmq_message(const zmq::message_t& msg, nl::json& json)
+        // LOCAL PATCH (mx-kernel) -- parts are kept as received and parsed
+        // on first access, rather than all four parsed here. See
+        // patches/README.md.
+        xmessage_part make_lazy_part(const zmq::message_t& msg)
+        {
+            return xmessage_part(std::make_shared<const std::string>(msg.data<const char>(), msg.size()));
+        }
+
+        // LOCAL PATCH (mx-kernel) -- frames are handed to ZMQ rather than
+        // copied into it. See patches/README.md.
+        //
+        // zmq::message_t(data, size) allocates and copies, so a large
+        // display_data or binary buffer was copied once more on its way out.
+        // Instead the dumped string, or the buffer itself, is moved to the
+        // heap and ZMQ frees it with the frame. Small frames are still copied,
+        // which costs no more than handing them over would.
+        constexpr std::size_t ADOPT_THRESHOLD = 64;
+
+        template <class T>
+        void release_frame(void*, void* hint)
         {
-            const char* buf = msg.data<const char>();
-            json = nl::json::parse(buf, buf + msg.size());
+            delete static_cast<T*>(hint);
+        }
+
+        template <class T>
+        zmq::message_t adopt_frame(T&& owner)
+        {
+            if (owner.size() < ADOPT_THRESHOLD)
+            {
+                return zmq::message_t(owner.data(), owner.size());
+            }
+            auto held = std::make_unique<T>(std::move(owner));
+            zmq::message_t frame(held->data(), held->size(), &release_frame<T>, held.get());
+            held.release();
+            return frame;
         }
 
         zmq::message_t write_zmq_message(const nl::json& json, nl::json::error_handler_t error_handler)
         {
-            std::string buffer = json.dump(-1, ' ', false, error_handler);
-            return zmq::message_t(buffer.c_str(), buffer.size());
+            return adopt_frame(json.dump(-1, ' ', false, error_handler));
+        }
+
+        void release_shared_frame(void*, void* hint)
+        {
+            delete static_cast<std::shared_ptr<const std::string>*>(hint);
+        }
+
+        // LOCAL PATCH (mx-kernel) -- a part that already holds its JSON text,
+        // such as a header from make_header_part, is sent as that text
+        // rather than parsed and dumped again. Large texts are shared with
+        // the frame rather than copied.
+        zmq::message_t write_zmq_part(const xmessage_part& part, nl::json::error_handler_t error_handler)
+        {
+            const std::shared_ptr<const std::string>& raw = part.raw();
+            if (!raw)
+            {
+                return write_zmq_message(part.value(), error_handler);
+            }
+            if (raw->size() < ADOPT_THRESHOLD)
+            {
+                return zmq::message_t(raw->data(), raw->size());
+            }
+            auto held = std::make_unique<std::shared_ptr<const std::string>>(raw);
+            zmq::message_t frame(const_cast<char*>(raw->data()), raw->size(), &release_shared_frame, held.get());
+            held.release();
+            return frame;
         }
     
         void serialize_message_base(xmessage_base&& msg,
@@ -49,10 +108,10 @@ namespace xeus
                                     nl::json::error_handler_t error_handler,
                                     zmq::multipart_t& wire_msg)
         {
-            zmq::message_t header = write_zmq_message(msg.header(), error_handler);
-            zmq::message_t parent_header = write_zmq_message(msg.parent_header(), error_handler);
-            zmq::message_t metadata = write_zmq_message(msg.metadata(), error_handler);
-            zmq::message_t content = write_zmq_message(msg.content(), error_handler);
+            zmq::message_t header = write_zmq_part(msg.header_part(), error_handler);
+            zmq::message_t parent_header = write_zmq_part(msg.parent_header_part(), error_handler);
+            zmq::message_t metadata = write_zmq_part(msg.metadata_part(), error_handler);
+            zmq::message_t content = write_zmq_part(msg.content_part(), error_handler);
             std::string sig = auth.sign(make_raw_buffer(header),
                                         make_raw_buffer(parent_header),
                                         make_raw_buffer(metadata),
@@ -66,13 +125,15 @@ namespace xeus
             wire_msg.add(std::move(content));
 
             // was not const and  could only be called on rvalues.
-            for (const binary_buffer& buffer : std::move(msg).buffers())
+            // LOCAL PATCH (mx-kernel) -- moved into their frames, not copied.
+            buffer_sequence buffers = std::move(msg).buffers();
+            for (binary_buffer& buffer : buffers)
             {
-                wire_msg.add(zmq::message_t(buffer.data(), buffer.size()));
+                wire_msg.add(adopt_frame(std::move(buffer)));
             }
         }
 
-        xmessage_base_data deserialize_message_base(zmq::multipart_t& wire_msg,
+        xmessage_raw_data deserialize_message_base(zmq::multipart_t& wire_msg,
                                                     const xauthentication& auth)
         {
             zmq::message_t signature = wire_msg.pop();
@@ -81,27 +142,36 @@ namespace xeus
             zmq::message_t metadata = wire_msg.pop();
             zmq::message_t content = wire_msg.pop();
 
-            xmessage_base_data data;
-            parse_zmq_message(header, data.m_header);
-            parse_zmq_message(parent_header, data.m_parent_header);
-            parse_zmq_message(metadata, data.m_metadata);
-            parse_zmq_message(content, data.m_content);
-
-            while (!wire_msg.empty())
-            {
-                zmq::message_t msg = wire_msg.pop();
-                const char* buf = msg.data<const char>();
-                data.m_buffers.emplace_back(buf, buf + msg.size());
-            }
-
-            // TODO: should we verify with buffers
+            // LOCAL PATCH (mx-kernel) -- verify the raw frames first, and
+            // parse only a message that passes. Parsing first let anyone who
+            // could reach the port make the server thread run four full JSON
+            // parses per forged message.
+            // The signature covers these four frames only; the protocol
+            // leaves buffers unsigned, so there is nothing more to verify.
             if (!auth.verify(make_raw_buffer(signature),
                              make_raw_buffer(header),
                              make_raw_buffer(parent_header),
                              make_raw_buffer(metadata),
                              make_raw_buffer(content)))
             {
-                throw std::runtime_error("ERROR: Signatures don't match");
+                throw xsignature_error("ERROR: Signatures don't match");
+            }
+
+            xmessage_raw_data data;
+            data.m_header = make_lazy_part(header);
+            data.m_parent_header = make_lazy_part(parent_header);
+            data.m_metadata = make_lazy_part(metadata);
+            data.m_content = make_lazy_part(content);
+
+            // LOCAL PATCH (mx-kernel) -- binary_buffer is a std::vector, so
+            // incoming buffers are still copied out of their frames; at least
+            // the sequence is sized once.
+            data.m_buffers.reserve(wire_msg.size());
+            while (!wire_msg.empty())
+            {
+                zmq::message_t msg = wire_msg.pop();
+                const char* buf = msg.data<const char>();
+                data.m_buffers.emplace_back(buf, buf + msg.size());
             }
 
             return data;
@@ -166,7 +236,7 @@ namespace xeus
                                          const xauthentication& auth)
     {
         xmessage::guid_list zmq_id = deserialize_zmq_id(wire_msg);
-        xmessage_base_data data = deserialize_message_base(wire_msg, auth);
+        xmessage_raw_data data = deserialize_message_base(wire_msg, auth);
         return xmessage(zmq_id, std::move(data));
     }
 
@@ -184,7 +254,7 @@ namespace xeus
                                                    const xauthentication& auth)
     {
         std::string topic = deserialize_topic(wire_msg);
-        xmessage_base_data data = deserialize_message_base(wire_msg, auth);
+        xmessage_raw_data data = deserialize_message_base(wire_msg, auth);
         return xpub_message(topic, std::move(data));
     }
 }
@@ -10,6 +10,8 @@
 #ifndef XEUS_ZMQ_SERIALIZER_HPP
 #define XEUS_ZMQ_SERIALIZER_HPP
 
+#include <stdexcept>
+
 #include "zmq_addon.hpp"
 
 #include "xeus/xmessage.hpp"
@@ -18,6 +20,17 @@
 
 namespace xeus
 {
+    // LOCAL PATCH (mx-kernel) -- thrown by deserialize when a message's
+    // signature does not match, before any of it has been parsed. Lets the
+    // server count rejected messages apart from other failures. See
+    // patches/README.md.
+    class xsignature_error : public std::runtime_error
+    {
+    public:
+
+        using std::runtime_error::runtime_error;
+    };
+
     class xzmq_serializer
     {
     public:
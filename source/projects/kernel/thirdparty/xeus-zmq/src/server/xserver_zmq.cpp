@@ -47,6 +47,16 @@ namespace xeus
         return m_poll_timeout;
     }
 
+    void xserver_zmq::wake()
+    {
+        p_impl->wake();
+    }
+
+    std::size_t xserver_zmq::rejected_messages() const
+    {
+        return p_impl->rejected_messages();
+    }
+
     void xserver_zmq::notify_idle()
     {
         if (m_idle_callback)
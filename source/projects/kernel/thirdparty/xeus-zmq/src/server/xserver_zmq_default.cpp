@@ -59,6 +59,9 @@ namespace xeus
     void xserver_zmq_default::stop_impl()
     {
         set_request_stop(true);
+        // LOCAL PATCH (mx-kernel) -- observe the request now rather than at
+        // the next poll timeout. See patches/README.md.
+        wake();
     }
 
     std::unique_ptr<xserver> make_xserver_default(xcontext& context,
@@ -35,6 +35,9 @@ namespace xeus
         , m_messenger(std::move(listener))
         , m_error_handler(eh)
         , m_request_stop(false)
+        , m_wakeup_rx(context, zmq::socket_type::pair)
+        , m_wakeup_tx(context, zmq::socket_type::pair)
+        , m_wakeup_pending(false)
     {
         init_socket(m_shell, config.m_transport, config.m_ip, config.m_shell_port);
         init_socket(m_controller, config.m_transport, config.m_ip, config.m_control_port);
@@ -46,6 +49,13 @@ namespace xeus
         m_publisher_controller.connect(get_controller_end_point("publisher"));
         m_heartbeat_controller.set(zmq::sockopt::linger, get_socket_linger());
         m_heartbeat_controller.connect(get_controller_end_point("heartbeat"));
+
+        // LOCAL PATCH (mx-kernel) -- see xserver_zmq::wake. Nothing is ever
+        // left queued on this pair that is worth delivering, so no linger.
+        m_wakeup_rx.set(zmq::sockopt::linger, 0);
+        m_wakeup_tx.set(zmq::sockopt::linger, 0);
+        m_wakeup_rx.bind("inproc://wakeup");
+        m_wakeup_tx.connect("inproc://wakeup");
     }
 
     void xserver_zmq_impl::start_publisher_thread()
@@ -76,6 +86,20 @@ namespace xeus
     {
         m_request_stop = stop;
     }
+
+    // LOCAL PATCH (mx-kernel) -- see xserver_zmq::wake.
+    void xserver_zmq_impl::wake()
+    {
+        if (m_wakeup_pending.exchange(true))
+        {
+            return; // a wake-up is already on its way
+        }
+
+        std::lock_guard<std::mutex> lock(m_wakeup_mutex);
+        zmq::message_t ping;
+        // Never block the caller: a full pipe already guarantees a wake-up.
+        (void)m_wakeup_tx.send(ping, zmq::send_flags::dontwait);
+    }
     
     bool xserver_zmq_impl::is_stopped() const
     {
@@ -84,10 +108,14 @@ namespace xeus
     
     auto xserver_zmq_impl::poll_channels(long timeout) -> std::optional<message_channel>
     {
+        // LOCAL PATCH (mx-kernel) -- the wake-up socket is polled as well, so
+        // another thread can cut the wait short. See xserver_zmq::wake.
         zmq::pollitem_t items[]
-            = { { m_controller, 0, ZMQ_POLLIN, 0 }, { m_shell, 0, ZMQ_POLLIN, 0 } };
+            = { { m_controller, 0, ZMQ_POLLIN, 0 },
+                { m_shell, 0, ZMQ_POLLIN, 0 },
+                { m_wakeup_rx, 0, ZMQ_POLLIN, 0 } };
 
-        zmq::poll(&items[0], 2, std::chrono::milliseconds(timeout));
+        zmq::poll(&items[0], 3, std::chrono::milliseconds(timeout));
 
         try
         {
@@ -107,14 +135,50 @@ namespace xeus
                 return { std::make_pair(std::move(msg), channel::SHELL) };
             }
         }
+        catch (const xsignature_error& e)
+        {
+            reject(e);
+        }
         catch (std::exception& e)
         {
             std::cerr << e.what() << std::endl;
         }
 
+        // LOCAL PATCH (mx-kernel) -- consume a wake-up only on the way to an
+        // idle tick; if a message was returned above, the frame stays queued
+        // and the next poll comes straight back here.
+        //
+        // Drain the frame, then clear the flag -- in that order. Only one
+        // frame can be in flight per clear, so the drain cannot swallow a
+        // frame sent for a later wake-up, and a wake() that still finds the
+        // flag set is covered by the idle tick this return leads to.
+        if (items[2].revents & ZMQ_POLLIN)
+        {
+            zmq::message_t ping;
+            while (m_wakeup_rx.recv(ping, zmq::recv_flags::dontwait))
+            {
+            }
+            m_wakeup_pending = false;
+        }
+
         return std::nullopt;
     }
 
+    std::size_t xserver_zmq_impl::rejected_messages() const
+    {
+        return m_rejected_messages.load();
+    }
+
+    // LOCAL PATCH (mx-kernel) -- anyone who can reach the ports can send
+    // these as fast as they like, so only the first is logged.
+    void xserver_zmq_impl::reject(const xsignature_error& e)
+    {
+        if (m_rejected_messages.fetch_add(1) == 0)
+        {
+            std::cerr << e.what() << " (further rejections are counted, not logged)" << std::endl;
+        }
+    }
+
     xcontrol_messenger& xserver_zmq_impl::get_control_messenger()
     {
         return m_messenger;
@@ -172,6 +236,10 @@ namespace xeus
                 xmessage msg = xzmq_serializer::deserialize(wire_msg, *p_auth);
                 l(std::move(msg));
             }
+            catch (const xsignature_error& e)
+            {
+                reject(e);
+            }
             catch (std::exception& e)
             {
                 std::cerr << e.what() << std::endl;
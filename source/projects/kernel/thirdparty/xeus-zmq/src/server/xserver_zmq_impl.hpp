@@ -12,6 +12,7 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 
 #include "zmq.hpp"
 #include "zmq_addon.hpp"
@@ -24,6 +25,7 @@
 #include "xeus-zmq/xthread.hpp"
 
 #include "../common/xauthentication.hpp"
+#include "../common/xzmq_serializer.hpp"
 #include "xpublisher.hpp"
 #include "xheartbeat.hpp"
 #include "xtrivial_messenger.hpp"
@@ -49,6 +51,12 @@ namespace xeus
         void set_request_stop(bool stop);
         bool is_stopped() const;
 
+        // LOCAL PATCH (mx-kernel) -- see xserver_zmq::wake.
+        void wake();
+
+        // LOCAL PATCH (mx-kernel) -- see xserver_zmq::rejected_messages.
+        std::size_t rejected_messages() const;
+
         using message_channel = std::pair<xmessage, channel>;
         std::optional<message_channel> poll_channels(long timeout);
 
@@ -92,6 +100,24 @@ namespace xeus
         // a data race, and the compiler is free to hoist the read out of the
         // loop, so a stop request could be missed entirely.
         std::atomic<bool> m_request_stop;
+
+        // LOCAL PATCH (mx-kernel) -- wake-up channel, polled alongside shell
+        // and control. The PAIR is split by thread: m_wakeup_rx belongs to the
+        // server thread like every other socket here, while m_wakeup_tx is
+        // written by whichever thread calls wake(), under m_wakeup_mutex
+        // because ZMQ sockets are not thread-safe. m_wakeup_pending coalesces
+        // wake-ups: only the first since the last drain sends a frame, so a
+        // burst costs one message rather than one per call.
+        zmq::socket_t m_wakeup_rx;
+        zmq::socket_t m_wakeup_tx;
+        std::mutex m_wakeup_mutex;
+        std::atomic<bool> m_wakeup_pending;
+
+        // LOCAL PATCH (mx-kernel) -- messages dropped for a bad signature.
+        // Written by the server thread, read from any.
+        std::atomic<std::size_t> m_rejected_messages{0};
+
+        void reject(const xsignature_error& e);
     };
 }
 
@@ -76,6 +76,10 @@ namespace xeus
         void update_display_data(nl::json data, nl::json metadata, nl::json transient);
         void publish_execution_input(const std::string& code, int execution_count);
         void publish_execution_result(int execution_count, nl::json data, nl::json metadata);
+        // LOCAL PATCH (mx-kernel) -- the same, with binary buffers attached to
+        // the message. See patches/README.md.
+        void publish_execution_result(int execution_count, nl::json data, nl::json metadata,
+                                      buffer_sequence buffers);
         void publish_execution_error(const std::string& ename,
                                      const std::string& evalue,
                                      const std::vector<std::string>& trace_back);
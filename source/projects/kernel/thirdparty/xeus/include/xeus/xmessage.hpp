@@ -10,6 +10,9 @@
 #ifndef XEUS_MESSAGE_HPP
 #define XEUS_MESSAGE_HPP
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -32,6 +35,64 @@ namespace xeus
         buffer_sequence m_buffers;
     };
 
+    // LOCAL PATCH (mx-kernel) -- messages parsed lazily. See
+    // patches/README.md.
+    //
+    // One JSON part of a message: either a value, or the bytes it arrived as,
+    // parsed on first access. Most requests only ever have their header and
+    // content read, so the parent header and metadata of an incoming message
+    // are never parsed at all. Copies share the bytes and the parsed value,
+    // which are never modified once set. The parse happens once, under
+    // std::call_once, however many copies or threads ask for the value first.
+    class XEUS_API xmessage_part
+    {
+    public:
+
+        xmessage_part() = default;
+        xmessage_part(nl::json value);
+        explicit xmessage_part(std::shared_ptr<const std::string> raw);
+        // LOCAL PATCH (mx-kernel) -- text and value known to agree, so
+        // neither has to be made from the other. See patches/README.md.
+        xmessage_part(std::shared_ptr<const std::string> raw, std::shared_ptr<const nl::json> value);
+
+        // Parses the raw bytes on first call; throws nl::json::parse_error if
+        // they are not JSON.
+        const nl::json& value() const;
+        std::shared_ptr<const nl::json> shared_value() const;
+
+        // The bytes this part was received as, or null for a part built from
+        // a value.
+        const std::shared_ptr<const std::string>& raw() const noexcept;
+        bool is_parsed() const noexcept;
+
+    private:
+
+        // Shared by the copies of a part made from bytes alone.
+        struct parse_state
+        {
+            std::once_flag m_parsed;
+            std::shared_ptr<const nl::json> p_value;
+            std::atomic<bool> m_done{false};
+        };
+
+        // Set at construction when the value is known, and then never
+        // changed.
+        std::shared_ptr<const nl::json> p_value;
+        std::shared_ptr<const std::string> p_raw;
+        std::shared_ptr<parse_state> p_parse;
+    };
+
+    // The four parts of a message, each a value or the bytes it was received
+    // or written as, and its buffers.
+    struct XEUS_API xmessage_raw_data
+    {
+        xmessage_part m_header;
+        xmessage_part m_parent_header;
+        xmessage_part m_metadata;
+        xmessage_part m_content;
+        buffer_sequence m_buffers;
+    };
+
     class XEUS_API xmessage_base
     {
     public:
@@ -44,6 +105,11 @@ namespace xeus
         const nl::json& metadata() const;
         const nl::json& content() const;
 
+        const xmessage_part& header_part() const noexcept;
+        const xmessage_part& parent_header_part() const noexcept;
+        const xmessage_part& metadata_part() const noexcept;
+        const xmessage_part& content_part() const noexcept;
+
         const buffer_sequence& buffers() const&;
         buffer_sequence&& buffers() &&;
 
@@ -56,6 +122,7 @@ namespace xeus
                       nl::json content,
                       buffer_sequence buffers);
         xmessage_base(xmessage_base_data&& data);
+        xmessage_base(xmessage_raw_data&& data);
         ~xmessage_base() = default;
 
         xmessage_base(xmessage_base&&) = default;
@@ -63,10 +130,10 @@ namespace xeus
 
     private:
 
-        nl::json m_header;
-        nl::json m_parent_header;
-        nl::json m_metadata;
-        nl::json m_content;
+        xmessage_part m_header;
+        xmessage_part m_parent_header;
+        xmessage_part m_metadata;
+        xmessage_part m_content;
         buffer_sequence m_buffers;
     };
 
@@ -86,6 +153,8 @@ namespace xeus
                  buffer_sequence buffers);
         xmessage(const guid_list& zmq_id,
                  xmessage_base_data&& data);
+        xmessage(const guid_list& zmq_id,
+                 xmessage_raw_data&& data);
 
         ~xmessage() = default;
 
@@ -117,6 +186,8 @@ namespace xeus
                      buffer_sequence buffers);
         xpub_message(const std::string& topic,
                      xmessage_base_data&& data);
+        xpub_message(const std::string& topic,
+                     xmessage_raw_data&& data);
 
         ~xpub_message() = default;
 
@@ -140,6 +211,13 @@ namespace xeus
     XEUS_API nl::json make_header(const std::string& msg_type,
                                   const std::string& user_name,
                                   const std::string& session_id);
+
+    // LOCAL PATCH (mx-kernel) -- the same header, as the JSON text the
+    // serializer sends; parsed only if something reads it. See
+    // patches/README.md.
+    XEUS_API xmessage_part make_header_part(const std::string& msg_type,
+                                            const std::string& user_name,
+                                            const std::string& session_id);
 }
 
 #endif
@@ -8,6 +8,7 @@
 #ifndef XEUS_REQUEST_CONTEXT_HPP
 #define XEUS_REQUEST_CONTEXT_HPP
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -25,15 +26,25 @@ namespace xeus
     
         using guid_list = xmessage::guid_list;
             
-        xrequest_context() = default;
+        xrequest_context();
         xrequest_context(nl::json header, guid_list id);    
+        // LOCAL PATCH (mx-kernel) -- a context for a received request keeps
+        // the header's bytes. See patches/README.md.
+        xrequest_context(xmessage_part header, guid_list id);
         
         const nl::json& header() const; 
         const guid_list& id() const;
 
+        // The header as JSON text, for the parent_header of every message
+        // published under this context. Written on first call, or the bytes
+        // the request arrived as; copies of the context share it either way.
+        const xmessage_part& header_part() const;
+
     private:
-            
-        nl::json m_header = nl::json::object();
+
+        struct header_state;
+
+        std::shared_ptr<header_state> p_header;
         guid_list m_id;
     };
 }
@@ -157,6 +157,13 @@ namespace xeus
     }
 
     void xinterpreter::publish_execution_result(int execution_count, nl::json data, nl::json metadata)
+    {
+        publish_execution_result(execution_count, std::move(data), std::move(metadata), buffer_sequence());
+    }
+
+    // LOCAL PATCH (mx-kernel) -- see the declaration.
+    void xinterpreter::publish_execution_result(int execution_count, nl::json data, nl::json metadata,
+                                                buffer_sequence buffers)
     {
         if (m_publisher)
         {
@@ -169,7 +176,7 @@ namespace xeus
                 "execute_result",
                 nl::json::object(),
                 std::move(content),
-                buffer_sequence()
+                std::move(buffers)
             );
         }
     }
@@ -11,6 +11,7 @@
 #include <exception>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <tuple>
 
@@ -35,6 +36,7 @@ namespace xeus
         : m_kernel_id(std::move(kernel_id))
         , m_user_name(std::move(user_name))
         , m_session_id(std::move(session_id))
+        , m_status_topic(get_topic("status"))
         , m_comm_manager(this)
         , p_logger(logger)
         , p_server(server)
@@ -70,7 +72,10 @@ namespace xeus
                                                  nl::json content,
                                                  buffer_sequence buffers)
         {
-            this->publish_message(msg_type, request_context.header(), std::move(metadata), std::move(content), std::move(buffers),
+            // LOCAL PATCH (mx-kernel) -- the context's header text, written
+            // once per request rather than once per message. See
+            // patches/README.md.
+            this->publish_message(msg_type, request_context.header_part(), std::move(metadata), std::move(content), std::move(buffers),
                                   channel::SHELL);
         });
 
@@ -79,7 +84,7 @@ namespace xeus
                                                    nl::json metadata,
                                                    nl::json content)
         {
-            this->send_stdin(msg_type, request_context.id(), request_context.header(), std::move(metadata), std::move(content));
+            this->send_stdin(msg_type, request_context.id(), request_context.header_part(), std::move(metadata), std::move(content));
         });
 
 
@@ -97,12 +102,11 @@ namespace xeus
         nl::json content;
         content["execution_state"] = "starting";
 
-        xpub_message msg(topic,
-                         make_header("status", m_user_name, m_session_id),
-                         nl::json::object(),
-                         nl::json::object(),
-                         std::move(content),
-                         buffer_sequence());
+        xpub_message msg(topic, make_message_data("status",
+                                                  nl::json::object(),
+                                                  nl::json::object(),
+                                                  std::move(content),
+                                                  buffer_sequence()));
         return msg;
     }
 
@@ -140,34 +144,32 @@ namespace xeus
     }
 
     void xkernel_core::publish_message(const std::string& msg_type,
-                                       nl::json parent_header,
+                                       xmessage_part parent_header,
                                        nl::json metadata,
                                        nl::json content,
                                        buffer_sequence buffers,
                                        channel c)
     {
-        xpub_message msg(get_topic(msg_type),
-                         make_header(msg_type, m_user_name, m_session_id),
-                         std::move(parent_header),
-                         std::move(metadata),
-                         std::move(content),
-                         std::move(buffers));
+        xpub_message msg(get_topic(msg_type), make_message_data(msg_type,
+                                                                std::move(parent_header),
+                                                                std::move(metadata),
+                                                                std::move(content),
+                                                                std::move(buffers)));
         p_logger->log_iopub_message(msg);
         p_server->publish(std::move(msg), c);
     }
 
     void xkernel_core::send_stdin(const std::string& msg_type,
                                   const guid_list& id_list,
-                                  nl::json parent_header,
+                                  xmessage_part parent_header,
                                   nl::json metadata,
                                   nl::json content)
     {
-        xmessage msg(id_list,
-                     make_header(msg_type, m_user_name, m_session_id),
-                     std::move(parent_header),
-                     std::move(metadata),
-                     std::move(content),
-                     buffer_sequence());
+        xmessage msg(id_list, make_message_data(msg_type,
+                                                std::move(parent_header),
+                                                std::move(metadata),
+                                                std::move(content),
+                                                buffer_sequence()));
         p_logger->log_sent_message(msg, xlogger::stdinput);
         p_server->send_stdin(std::move(msg));
     }
@@ -194,11 +196,28 @@ namespace xeus
 
     void xkernel_core::dispatch(xmessage msg, channel c)
     {
-        p_logger->log_received_message(msg, c == channel::SHELL ? xlogger::shell : xlogger::control);
-        // Copy because the msg is moved after, and we may need the header
-        // for publishing the status.
-        nl::json header = msg.header();
-        publish_status(header, "busy", c);
+        // LOCAL PATCH (mx-kernel) -- the header is borrowed from the message
+        // rather than copied: the handler may move the message, so this
+        // keeps a share of its header part, parsed value and received bytes
+        // both, for the statuses. Parts are parsed on first access now, so a
+        // header that is not JSON throws here rather than in the server. See
+        // patches/README.md.
+        xmessage_part request_header;
+        try
+        {
+            p_logger->log_received_message(msg, c == channel::SHELL ? xlogger::shell : xlogger::control);
+            // Parsed before it is shared, so the copy and the message share
+            // the one value.
+            msg.header();
+            request_header = msg.header_part();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: received bad message: " << e.what() << std::endl;
+            return;
+        }
+        const nl::json& header = request_header.value();
+        publish_status(request_header, "busy", c);
 
         std::string msg_type = header.value("msg_type", "");
         handler_type handler = get_handler(msg_type);
@@ -222,10 +241,28 @@ namespace xeus
         // async handlers need to set the idle status themselves
         if(handler.blocking)
         {
-            publish_status(header, "idle", c);
+            publish_status(request_header, "idle", c);
         }
     }
 
+    // LOCAL PATCH (mx-kernel) -- every message the kernel sends gets its
+    // header from make_header_part, as the JSON text the serializer sends.
+    // See patches/README.md.
+    xmessage_raw_data xkernel_core::make_message_data(const std::string& msg_type,
+                                                      xmessage_part parent_header,
+                                                      xmessage_part metadata,
+                                                      xmessage_part content,
+                                                      buffer_sequence buffers) const
+    {
+        xmessage_raw_data data;
+        data.m_header = make_header_part(msg_type, m_user_name, m_session_id);
+        data.m_parent_header = std::move(parent_header);
+        data.m_metadata = std::move(metadata);
+        data.m_content = std::move(content);
+        data.m_buffers = std::move(buffers);
+        return data;
+    }
+
     auto xkernel_core::get_handler(const std::string& msg_type) -> handler_type
     {
         auto iter = m_handler.find(msg_type);
@@ -247,7 +284,9 @@ namespace xeus
             bool allow_stdin = content.value("allow_stdin", true);
             bool stop_on_error = content.value("stop_on_error", false);
 
-            xrequest_context request_context(request.header(), request.identities());
+            // LOCAL PATCH (mx-kernel) -- the header part, so the cell's output
+            // is parented with the bytes the request arrived as.
+            xrequest_context request_context(request.header_part(), request.identities());
             execute_request_config config { silent, store_history, allow_stdin };
             
             auto reply_callback = [this, request_context, config, stop_on_error, code](nl::json reply)
@@ -261,7 +300,7 @@ namespace xeus
                 send_reply(
                     request_context.id(),
                     "execute_reply", 
-                    request_context.header(),
+                    request_context.header_part(),
                     std::move(metadata), 
                     std::move(reply), 
                     channel::SHELL
@@ -278,7 +317,7 @@ namespace xeus
                 }
 
                 // idle
-                publish_status(request_context.header(), "idle", channel::SHELL);
+                publish_status(request_context.header_part(), "idle", channel::SHELL);
             };
 
             p_interpreter->execute_request(
@@ -302,7 +341,7 @@ namespace xeus
         std::string code = content.value("code", "");
         int cursor_pos = content.value("cursor_pos", -1);
         nl::json reply = p_interpreter->complete_request(code, cursor_pos);
-        send_reply(request.identities(), "complete_reply", request.header(),
+        send_reply(request.identities(), "complete_reply", request.header_part(),
             nl::json::object(), std::move(reply), c);
     }
 
@@ -313,7 +352,7 @@ namespace xeus
         int cursor_pos = content.value("cursor_pos", -1);
         int detail_level = content.value("detail_level", 0);
         nl::json reply = p_interpreter->inspect_request(code, cursor_pos, detail_level);
-        send_reply(request.identities(), "inspect_reply", request.header(), nl::json::object(), std::move(reply), c);
+        send_reply(request.identities(), "inspect_reply", request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::history_request(xmessage request, channel c)
@@ -322,7 +361,7 @@ namespace xeus
 
         nl::json history = p_history_manager->process_request(content);
 
-        send_reply(request.identities(), "history_reply",  request.header(), nl::json::object(), std::move(history), c);
+        send_reply(request.identities(), "history_reply",  request.header_part(), nl::json::object(), std::move(history), c);
     }
 
     void xkernel_core::is_complete_request(xmessage request, channel c)
@@ -330,7 +369,7 @@ namespace xeus
         const nl::json& content = request.content();
         std::string code = content.value("code", "");
         nl::json reply = p_interpreter->is_complete_request(code);
-        send_reply(request.identities(), "is_complete_reply", request.header(), nl::json::object(), std::move(reply), c);
+        send_reply(request.identities(), "is_complete_reply", request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::comm_info_request(xmessage request, channel c)
@@ -351,14 +390,14 @@ namespace xeus
         nl::json reply;
         reply["comms"] = comms;
         reply["status"] = "ok";
-        send_reply(request.identities(), "comm_info_reply",request.header(), nl::json::object(), std::move(reply), c);
+        send_reply(request.identities(), "comm_info_reply",request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::kernel_info_request(xmessage request, channel c)
     {
         nl::json reply = p_interpreter->kernel_info_request();
         reply["protocol_version"] = get_protocol_version();
-        send_reply(request.identities(), "kernel_info_reply", request.header(), nl::json::object(), std::move(reply), c);
+        send_reply(request.identities(), "kernel_info_reply", request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::shutdown_request(xmessage request, channel c)
@@ -369,15 +408,15 @@ namespace xeus
         p_server->stop();
         nl::json reply;
         reply["restart"] = restart;
-        publish_message("shutdown", request.header(), nl::json::object(), std::move(reply), buffer_sequence(), channel::CONTROL);
-        send_reply(request.identities(), "shutdown_reply", request.header(), nl::json::object(), std::move(reply), c);
+        publish_message("shutdown", request.header_part(), nl::json::object(), std::move(reply), buffer_sequence(), channel::CONTROL);
+        send_reply(request.identities(), "shutdown_reply", request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::interrupt_request(xmessage request, channel c)
     {
         nl::json reply = nl::json::object();
-        publish_message("interrupt", request.header(), nl::json::object(), std::move(reply), buffer_sequence(), channel::CONTROL);
-        send_reply(request.identities(), "interrupt_reply", request.header(), nl::json::object(), std::move(reply), c);
+        publish_message("interrupt", request.header_part(), nl::json::object(), std::move(reply), buffer_sequence(), channel::CONTROL);
+        send_reply(request.identities(), "interrupt_reply", request.header_part(), nl::json::object(), std::move(reply), c);
     }
 
     void xkernel_core::debug_request(xmessage request, channel c)
@@ -386,15 +425,55 @@ namespace xeus
         {
             nl::json reply = p_debugger->process_request(request.header(), request.content());
             nl::json metadata = get_metadata();
-            send_reply(request.identities(), "debug_reply", request.header(), std::move(metadata), std::move(reply), c);
+            send_reply(request.identities(), "debug_reply", request.header_part(), std::move(metadata), std::move(reply), c);
         }
     }
 
-    void xkernel_core::publish_status(nl::json parent_header, const std::string& status, channel c)
+    namespace
     {
-        nl::json content;
-        content["execution_state"] = status;
-        publish_message("status", parent_header, nl::json::object(), std::move(content), buffer_sequence(), c);
+        // A part whose text is written once and then shared by every message
+        // that carries it. Parsed up front, so no copy ever parses it, and
+        // copies on several threads only ever read.
+        xmessage_part make_constant_part(const nl::json& value)
+        {
+            xmessage_part part(std::make_shared<const std::string>(value.dump()));
+            part.value();
+            return part;
+        }
+
+        xmessage_part status_content(const std::string& status)
+        {
+            static const xmessage_part busy = make_constant_part({{"execution_state", "busy"}});
+            static const xmessage_part idle = make_constant_part({{"execution_state", "idle"}});
+            if (status == "busy")
+            {
+                return busy;
+            }
+            if (status == "idle")
+            {
+                return idle;
+            }
+            return nl::json{{"execution_state", status}};
+        }
+    }
+
+    // LOCAL PATCH (mx-kernel) -- a status fast path. See patches/README.md.
+    //
+    // Every request is bracketed by a busy and an idle status. Each used to
+    // dump its parent header, metadata and content afresh. Now the parent is
+    // the request's header part, sent as the bytes it arrived as, the
+    // metadata and content are constant texts written once, and only the
+    // header -- new msg_id and date -- is written per message before signing.
+    void xkernel_core::publish_status(const xmessage_part& parent_header, const std::string& status, channel c)
+    {
+        static const xmessage_part empty_metadata = make_constant_part(nl::json::object());
+        xpub_message msg(m_status_topic, make_message_data("status",
+                                                           parent_header,
+                                                           empty_metadata,
+                                                           status_content(status),
+                                                           buffer_sequence()));
+        p_logger->log_iopub_message(msg);
+        p_server->publish(std::move(msg), c);
     }
 
     void xkernel_core::publish_execute_input(nl::json parent_header,
@@ -412,19 +491,21 @@ namespace xeus
                          channel::SHELL);
     }
 
+    // LOCAL PATCH (mx-kernel) -- the parent header is a part, so a reply
+    // carries its request's header as the bytes it arrived as. See
+    // patches/README.md.
     void xkernel_core::send_reply(const guid_list& id_list,
                                   const std::string& reply_type,
-                                  nl::json parent_header,
+                                  xmessage_part parent_header,
                                   nl::json metadata,
                                   nl::json reply_content,
                                   channel c)
     {
-        xmessage reply(id_list,
-                       make_header(reply_type, m_user_name, m_session_id),
-                       std::move(parent_header),
-                       std::move(metadata),
-                       std::move(reply_content),
-                       buffer_sequence());
+        xmessage reply(id_list, make_message_data(reply_type,
+                                                  std::move(parent_header),
+                                                  std::move(metadata),
+                                                  std::move(reply_content),
+                                                  buffer_sequence()));
         p_logger->log_sent_message(reply, c == channel::SHELL ? xlogger::shell : xlogger::control);
         if (c == channel::SHELL)
         {
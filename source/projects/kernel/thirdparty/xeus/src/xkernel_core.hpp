@@ -57,13 +57,13 @@ namespace xeus
         nl::json dispatch_internal(nl::json msg);
  
         void publish_message(const std::string& msg_type,
-                             nl::json parent_header,
+                             xmessage_part parent_header,
                              nl::json metadata,
                              nl::json content,
                              buffer_sequence buffers,
                              channel origin);
 
-        void send_stdin(const std::string& msg_type, const guid_list& id_list, nl::json parent_header, nl::json metadata, nl::json content);
+        void send_stdin(const std::string& msg_type, const guid_list& id_list, xmessage_part parent_header, nl::json metadata, nl::json content);
 
         xcomm_manager& comm_manager() & noexcept;
         const xcomm_manager& comm_manager() const & noexcept;
@@ -100,18 +100,24 @@ namespace xeus
         void interrupt_request(xmessage request, channel c);
         void debug_request(xmessage request, channel c);
 
-        void publish_status(nl::json parent_header, const std::string& status, channel c);
+        void publish_status(const xmessage_part& parent_header, const std::string& status, channel c);
         void publish_execute_input(nl::json parent_header, const std::string& code, int execution_count);
 
         void send_reply(const guid_list& id_list,
                         const std::string& reply_type,
-                        nl::json parent_header,
+                        xmessage_part parent_header,
                         nl::json metadata,
                         nl::json reply_content,
                         channel c);
 
         void abort_request(xmessage msg);
 
+        xmessage_raw_data make_message_data(const std::string& msg_type,
+                                            xmessage_part parent_header,
+                                            xmessage_part metadata,
+                                            xmessage_part content,
+                                            buffer_sequence buffers) const;
+
         std::string get_topic(const std::string& msg_type) const;
         nl::json get_metadata() const;
 
@@ -119,6 +125,8 @@ namespace xeus
         std::string m_kernel_id;
         std::string m_user_name;
         std::string m_session_id;
+        // LOCAL PATCH (mx-kernel) -- built once for the status fast path.
+        std::string m_status_topic;
 
         std::map<std::string, handler_type> m_handler;
         xcomm_manager m_comm_manager;
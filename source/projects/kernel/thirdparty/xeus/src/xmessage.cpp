@@ -7,9 +7,16 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <array>
+#include <charconv>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <iomanip>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <stdexcept>
 #include <sstream>
 #include <string>
@@ -24,6 +31,72 @@ namespace nl = nlohmann;
 
 namespace xeus
 {
+    // LOCAL PATCH (mx-kernel) -- messages parsed lazily. See
+    // patches/README.md.
+    xmessage_part::xmessage_part(nl::json value)
+        : p_value(std::make_shared<const nl::json>(std::move(value)))
+    {
+    }
+
+    xmessage_part::xmessage_part(std::shared_ptr<const std::string> raw)
+        : p_raw(std::move(raw))
+        , p_parse(p_raw ? std::make_shared<parse_state>() : nullptr)
+    {
+    }
+
+    xmessage_part::xmessage_part(std::shared_ptr<const std::string> raw, std::shared_ptr<const nl::json> value)
+        : p_value(std::move(value))
+        , p_raw(std::move(raw))
+    {
+    }
+
+    const nl::json& xmessage_part::value() const
+    {
+        if (p_value)
+        {
+            return *p_value;
+        }
+        if (!p_parse)
+        {
+            static const nl::json null_value;
+            return null_value;
+        }
+        // A parse that throws leaves the flag unset, and the next caller
+        // tries again.
+        std::call_once(p_parse->m_parsed, [this]()
+        {
+            p_parse->p_value = std::make_shared<const nl::json>(nl::json::parse(*p_raw));
+            p_parse->m_done.store(true, std::memory_order_release);
+        });
+        return *p_parse->p_value;
+    }
+
+    std::shared_ptr<const nl::json> xmessage_part::shared_value() const
+    {
+        if (p_value)
+        {
+            return p_value;
+        }
+        if (!p_parse)
+        {
+            static const auto null_value = std::make_shared<const nl::json>();
+            return null_value;
+        }
+        value();
+        return p_parse->p_value;
+    }
+
+    const std::shared_ptr<const std::string>& xmessage_part::raw() const noexcept
+    {
+        return p_raw;
+    }
+
+    bool xmessage_part::is_parsed() const noexcept
+    {
+        return p_value != nullptr
+            || (p_parse && p_parse->m_done.load(std::memory_order_acquire));
+    }
+
     xmessage_base::xmessage_base(
         nl::json header, nl::json parent_header, nl::json metadata, nl::json content, buffer_sequence buffers)
         : m_header(std::move(header))
@@ -34,22 +107,51 @@ namespace xeus
     {
     }
 
+    xmessage_base::xmessage_base(xmessage_raw_data&& data)
+        : m_header(std::move(data.m_header))
+        , m_parent_header(std::move(data.m_parent_header))
+        , m_metadata(std::move(data.m_metadata))
+        , m_content(std::move(data.m_content))
+        , m_buffers(std::move(data.m_buffers))
+    {
+    }
+
     const nl::json& xmessage_base::header() const
     {
-        return m_header;
+        return m_header.value();
     }
 
     const nl::json& xmessage_base::parent_header() const
     {
-        return m_parent_header;
+        return m_parent_header.value();
     }
 
     const nl::json& xmessage_base::metadata() const
     {
-        return m_metadata;
+        return m_metadata.value();
     }
 
     const nl::json& xmessage_base::content() const
+    {
+        return m_content.value();
+    }
+
+    const xmessage_part& xmessage_base::header_part() const noexcept
+    {
+        return m_header;
+    }
+
+    const xmessage_part& xmessage_base::parent_header_part() const noexcept
+    {
+        return m_parent_header;
+    }
+
+    const xmessage_part& xmessage_base::metadata_part() const noexcept
+    {
+        return m_metadata;
+    }
+
+    const xmessage_part& xmessage_base::content_part() const noexcept
     {
         return m_content;
     }
@@ -90,6 +192,13 @@ namespace xeus
     {
     }
 
+    xmessage::xmessage(const guid_list& zmq_id,
+                       xmessage_raw_data&& data)
+        : xmessage_base(std::move(data))
+        , m_zmq_id(zmq_id)
+    {
+    }
+
     auto xmessage::identities() const -> const guid_list&
     {
         return m_zmq_id;
@@ -121,28 +230,199 @@ namespace xeus
     {
     }
 
+    xpub_message::xpub_message(const std::string& topic,
+                               xmessage_raw_data&& data)
+        : xmessage_base(std::move(data))
+        , m_topic(topic)
+    {
+    }
+
     const std::string& xpub_message::topic() const
     {
         return m_topic;
     }
 
-    std::string iso8601_now()
+    // LOCAL PATCH (mx-kernel) -- a header factory that writes the header's
+    // bytes directly. See patches/README.md.
+    //
+    // A header was six insertions into a fresh nl::json object, a libuuid
+    // call for its id, and an ostringstream and gmtime for its date, then
+    // dumped again by the serializer. Every status, stream line and reply
+    // has one. Now the date's seconds are formatted once per second per
+    // thread, message ids come from a per-thread generator seeded from the
+    // OS, and make_header_part writes the JSON text itself.
+    namespace
     {
-        std::ostringstream ss;
+        // "YYYY-MM-DDTHH:MM:SS" for a count of seconds since the epoch. From
+        // Howard Hinnant's civil_from_days, so no gmtime and no lock.
+        void format_seconds(std::int64_t seconds, char* out)
+        {
+            std::int64_t days = seconds / 86400;
+            std::int64_t rem = seconds % 86400;
+            if (rem < 0)
+            {
+                rem += 86400;
+                --days;
+            }
+            days += 719468;
+            const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+            const std::int64_t doe = days - era * 146097;
+            const std::int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            const std::int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            const std::int64_t mp = (5 * doy + 2) / 153;
+            const std::int64_t day = doy - (153 * mp + 2) / 5 + 1;
+            const std::int64_t month = mp < 10 ? mp + 3 : mp - 9;
+            const std::int64_t year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+            const auto digits = [](std::int64_t value, char* at, int width)
+            {
+                for (int i = width - 1; i >= 0; --i)
+                {
+                    at[i] = static_cast<char>('0' + value % 10);
+                    value /= 10;
+                }
+            };
+            digits(year, out, 4);
+            out[4] = '-';
+            digits(month, out + 5, 2);
+            out[7] = '-';
+            digits(day, out + 8, 2);
+            out[10] = 'T';
+            digits(rem / 3600, out + 11, 2);
+            out[13] = ':';
+            digits(rem / 60 % 60, out + 14, 2);
+            out[16] = ':';
+            digits(rem % 60, out + 17, 2);
+        }
 
-        // now
-        auto now = std::chrono::system_clock::now();
+        constexpr std::size_t SECONDS_SIZE = 19;
 
-        // down to seconds
-        auto itt = std::chrono::system_clock::to_time_t(now);
-        ss << std::put_time(std::gmtime(&itt), "%FT%T");
+        // Appends the current UTC time as "YYYY-MM-DDTHH:MM:SS.ffffffZ".
+        void append_iso8601_now(std::string& out)
+        {
+            struct cached_second
+            {
+                std::int64_t seconds = INT64_MIN;
+                char text[SECONDS_SIZE];
+            };
+            thread_local cached_second cache;
 
-        // down to microseconds
-        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
-        auto fractionals = micros.count() % 1000000;
-        ss << "." << fractionals << "Z";
+            const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            std::int64_t seconds = micros / 1000000;
+            std::int64_t fraction = micros % 1000000;
+            if (fraction < 0)
+            {
+                fraction += 1000000;
+                --seconds;
+            }
+            if (seconds != cache.seconds)
+            {
+                format_seconds(seconds, cache.text);
+                cache.seconds = seconds;
+            }
+            out.append(cache.text, SECONDS_SIZE);
 
-        return ss.str();
+            // Six digits always: ".000042", not ".42".
+            char digits[8] = {'.', '0', '0', '0', '0', '0', '0', 'Z'};
+            char number[7];
+            const auto result = std::to_chars(number, number + sizeof(number), fraction);
+            const auto length = result.ptr - number;
+            std::copy(number, result.ptr, digits + 7 - length);
+            out.append(digits, sizeof(digits));
+        }
+
+        // A fresh message id, 32 hex digits laid out like a version 4 UUID,
+        // as new_xguid returns. Message ids only need to be unique, not
+        // secret, so rather than a system call each, they come from a
+        // xoshiro256** generator per thread, seeded with 256 bits from
+        // std::random_device -- the OS's CSPRNG on every platform xeus
+        // builds for. Keys and session ids still use new_xguid.
+        class xid_generator
+        {
+        public:
+
+            xid_generator()
+            {
+                std::random_device device;
+                for (std::uint64_t& word : m_state)
+                {
+                    word = (std::uint64_t(device()) << 32) | device();
+                }
+            }
+
+            void append(std::string& out)
+            {
+                static constexpr char hex[] = "0123456789abcdef";
+                std::uint64_t high = next();
+                std::uint64_t low = next();
+                high = (high & ~std::uint64_t(0xf000)) | 0x4000;                 // version 4
+                low = (low & ~(std::uint64_t(0xc) << 60)) | (std::uint64_t(0x8) << 60); // variant 1
+                char text[32];
+                for (int i = 15; i >= 0; --i)
+                {
+                    text[i] = hex[high & 0xf];
+                    text[16 + i] = hex[low & 0xf];
+                    high >>= 4;
+                    low >>= 4;
+                }
+                out.append(text, sizeof(text));
+            }
+
+        private:
+
+            static std::uint64_t rotl(std::uint64_t x, int k)
+            {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            std::uint64_t next()
+            {
+                const std::uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+                const std::uint64_t t = m_state[1] << 17;
+                m_state[2] ^= m_state[0];
+                m_state[3] ^= m_state[1];
+                m_state[1] ^= m_state[2];
+                m_state[0] ^= m_state[3];
+                m_state[2] ^= t;
+                m_state[3] = rotl(m_state[3], 45);
+                return result;
+            }
+
+            std::array<std::uint64_t, 4> m_state;
+        };
+
+        void append_message_id(std::string& out)
+        {
+            thread_local xid_generator generator;
+            generator.append(out);
+        }
+
+        // A JSON string, escaped as nl::json::dump would escape it. Names and
+        // message types seldom need escaping, so that case is handed to
+        // nl::json rather than duplicated here.
+        void append_json_string(const std::string& text, std::string& out)
+        {
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20)
+                {
+                    out += nl::json(text).dump();
+                    return;
+                }
+            }
+            out += '"';
+            out += text;
+            out += '"';
+        }
+    }
+
+    std::string iso8601_now()
+    {
+        std::string date;
+        date.reserve(SECONDS_SIZE + 8);
+        append_iso8601_now(date);
+        return date;
     }
 
     std::string get_protocol_version()
@@ -154,8 +434,14 @@ namespace xeus
                       const std::string& user_name,
                       const std::string& session_id)
     {
+        // LOCAL PATCH (mx-kernel) -- the same ids and dates as
+        // make_header_part.
+        std::string msg_id;
+        msg_id.reserve(32);
+        append_message_id(msg_id);
+
         nl::json header;
-        header["msg_id"] = new_xguid();
+        header["msg_id"] = std::move(msg_id);
         header["username"] = user_name;
         header["session"] = session_id;
         header["date"] = iso8601_now();
@@ -163,4 +449,28 @@ namespace xeus
         header["version"] = get_protocol_version();
         return header;
     }
+
+    xmessage_part make_header_part(const std::string& msg_type,
+                                   const std::string& user_name,
+                                   const std::string& session_id)
+    {
+        // Keys in nl::json's order, so these are the bytes dump() would give.
+        static const std::string version = nl::json(get_protocol_version()).dump();
+        auto text = std::make_shared<std::string>();
+        text->reserve(160 + msg_type.size() + user_name.size() + session_id.size());
+        *text += "{\"date\":\"";
+        append_iso8601_now(*text);
+        *text += "\",\"msg_id\":\"";
+        append_message_id(*text);
+        *text += "\",\"msg_type\":";
+        append_json_string(msg_type, *text);
+        *text += ",\"session\":";
+        append_json_string(session_id, *text);
+        *text += ",\"username\":";
+        append_json_string(user_name, *text);
+        *text += ",\"version\":";
+        *text += version;
+        *text += '}';
+        return xmessage_part(std::shared_ptr<const std::string>(std::move(text)));
+    }
 }
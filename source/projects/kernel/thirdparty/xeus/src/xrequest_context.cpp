@@ -1,19 +1,76 @@
 #include "xeus/xrequest_context.hpp"
 
+#include <mutex>
+
 namespace xeus
 {
+    // LOCAL PATCH (mx-kernel) -- the header is shared by every copy of the
+    // context, so the text for parent_header is written at most once however
+    // many messages a cell publishes. See patches/README.md.
+    struct xrequest_context::header_state
+    {
+        explicit header_state(xmessage_part header)
+            : m_header(std::move(header))
+        {
+            // Parsed now, so header() only ever reads, from any thread.
+            m_header.value();
+        }
+
+        xmessage_part m_header;
+        std::once_flag m_written;
+        xmessage_part m_text;
+    };
+
+    xrequest_context::xrequest_context()
+        : xrequest_context(nl::json::object(), guid_list())
+    {
+    }
+
     xrequest_context::xrequest_context(nl::json header, guid_list id)
-        : m_header(std::move(header)), m_id(std::move(id))
+        : xrequest_context(xmessage_part(std::move(header)), std::move(id))
+    {
+    }
+
+    xrequest_context::xrequest_context(xmessage_part header, guid_list id)
+        : p_header(std::make_shared<header_state>(std::move(header))), m_id(std::move(id))
     {
     }
 
     const nl::json& xrequest_context::header() const
     {
-        return m_header;
+        if (!p_header)
+        {
+            // Moved from.
+            static const nl::json empty = nl::json::object();
+            return empty;
+        }
+        return p_header->m_header.value();
     }
 
     const xmessage::guid_list& xrequest_context::id() const
     {
         return m_id;
     }
+
+    const xmessage_part& xrequest_context::header_part() const
+    {
+        if (!p_header)
+        {
+            // Moved from.
+            static const xmessage_part empty(std::make_shared<const std::string>("{}"),
+                                             std::make_shared<const nl::json>(nl::json::object()));
+            return empty;
+        }
+        header_state& state = *p_header;
+        if (state.m_header.raw())
+        {
+            return state.m_header;
+        }
+        std::call_once(state.m_written, [&state]
+        {
+            state.m_text = xmessage_part(std::make_shared<const std::string>(state.m_header.value().dump()),
+                                         state.m_header.shared_value());
+        });
+        return state.m_text;
+    }
 }
@@ -0,0 +1,120 @@
+#pragma once
+
+// typed_array -- numbers from the patch packed for a binary result.
+//
+// `result array 0.5 0.25 ...` would otherwise reach the client as text:
+// every number formatted in decimal on Max's main thread and parsed again on
+// the other end, at two to three times the size. Here the numbers are packed
+// contiguously as int64, or float64 if any of them is a float, in the host's
+// byte order. The interpreter attaches the bytes to the execute_result as a
+// binary buffer and describes them -- dtype, shape, byte order -- in its
+// metadata.
+//
+// The byte vector is xeus::binary_buffer's type, so it is moved, not copied,
+// into the message. Max-free.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mx {
+
+enum class array_dtype : uint8_t { int64, float64 };
+
+inline const char* dtype_name(array_dtype t) {
+    return t == array_dtype::int64 ? "int64" : "float64";
+}
+
+inline const char* host_byte_order() {
+    const uint16_t probe = 1;
+    unsigned char first = 0;
+    std::memcpy(&first, &probe, 1);
+    return first == 1 ? "little" : "big";
+}
+
+class typed_array {
+public:
+    // Integers are stored as int64 until the first double arrives, at which
+    // point everything so far is converted in place: both are eight bytes.
+    void add(long long value) {
+        if (m_dtype == array_dtype::float64) {
+            add(static_cast<double>(value));
+            return;
+        }
+        append(&value);
+    }
+
+    void add(double value) {
+        if (m_dtype == array_dtype::int64) {
+            promote();
+        }
+        append(&value);
+    }
+
+    array_dtype dtype() const { return m_dtype; }
+    size_t count() const { return m_bytes.size() / 8; }
+    bool empty() const { return m_bytes.empty(); }
+
+    // Defaults to one dimension of count().
+    std::vector<size_t> shape() const {
+        return m_shape.empty() ? std::vector<size_t>{count()} : m_shape;
+    }
+    // The caller is responsible for the product matching count().
+    void set_shape(std::vector<size_t> shape) { m_shape = std::move(shape); }
+
+    long long integer(size_t i) const { return read<long long>(i); }
+    double real(size_t i) const { return read<double>(i); }
+
+    const std::vector<char>& bytes() const { return m_bytes; }
+    std::vector<char> take_bytes() { return std::move(m_bytes); }
+
+private:
+    template <typename T>
+    void append(const T* value) {
+        const char* p = reinterpret_cast<const char*>(value);
+        m_bytes.insert(m_bytes.end(), p, p + sizeof(T));
+    }
+
+    template <typename T>
+    T read(size_t i) const {
+        T value;
+        std::memcpy(&value, m_bytes.data() + i * 8, sizeof(T));
+        return value;
+    }
+
+    void promote() {
+        for (size_t i = 0; i < count(); ++i) {
+            const double value = static_cast<double>(read<long long>(i));
+            std::memcpy(m_bytes.data() + i * 8, &value, sizeof(value));
+        }
+        m_dtype = array_dtype::float64;
+    }
+
+    static_assert(sizeof(long long) == 8 && sizeof(double) == 8,
+                  "int64 and float64 must both be eight bytes");
+
+    std::vector<char> m_bytes;
+    array_dtype m_dtype = array_dtype::int64;
+    std::vector<size_t> m_shape;
+};
+
+// "array(float64, shape=[2, 3])" -- the text/plain form of an array result.
+inline std::string describe(const typed_array& a) {
+    std::string text = "array(";
+    text += dtype_name(a.dtype());
+    text += ", shape=[";
+    const auto shape = a.shape();
+    for (size_t i = 0; i < shape.size(); ++i) {
+        if (i > 0) {
+            text += ", ";
+        }
+        text += std::to_string(shape[i]);
+    }
+    text += "])";
+    return text;
+}
+
+} // namespace mx
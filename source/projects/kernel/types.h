@@ -8,6 +8,7 @@
 #include <thread>
 
 #include "message_queue.h"
+#include "outlet_drain.h"
 
 // Forward declarations for xeus types (avoid pulling in heavy headers)
 namespace xeus {
@@ -51,12 +52,32 @@ struct t_kernel_impl {
     std::thread* kernel_thread = nullptr;
     std::string connection_file;
 
-    // Kernel thread -> main thread (drained by the qelem callback).
-    ThreadSafeQueue<OutletMessage> outlet_queue;
-    // Main thread -> kernel thread, replying to the cell currently executing.
-    ThreadSafeQueue<ResultMessage> result_queue;
-    // Main thread -> kernel thread, output not tied to any cell.
-    ThreadSafeQueue<ResultMessage> async_queue;
+    // Kernel thread -> main thread (drained by the qelem callback). Only the
+    // server thread pushes and only the qelem pops, so this one is lock-free.
+    // One message per started cell, so it only fills if Max stops draining.
+    SpscRing<OutletMessage> outlet_queue{1024};
+    // Delivered messages, main thread -> kernel thread, emptied but with
+    // their buffers intact for the next message to reuse.
+    SpscRing<OutletMessage> outlet_free{1024};
+    // Delivers outlet_queue to Max a budget's worth per qelem run. Main
+    // thread only.
+    OutletDrain outlet_drain;
+    // Max -> kernel thread, replying to the cell currently executing.
+    //
+    // These two stay locked queues: Max delivers `result` and `print` on the
+    // main thread, but also on the scheduler thread when Overdrive is on and
+    // the message comes from a timed source such as [metro]. That is two
+    // producers, which a single-producer ring cannot take.
+    //
+    // Both are bounded, so a patch printing faster than the server thread
+    // publishes cannot grow them without limit: past k_max_queue messages a
+    // push is dropped and counted, and the interpreter reports the count on
+    // stderr with the rate-limit summary. The IOPub rate limits only act once
+    // a message is off the queue.
+    static constexpr size_t k_max_queue = 8192;
+    ThreadSafeQueue<ResultMessage> result_queue{k_max_queue};
+    // Max -> kernel thread, output not tied to any cell.
+    ThreadSafeQueue<ResultMessage> async_queue{k_max_queue};
 
     // False once the Max object is being torn down. The kernel thread checks
     // this to abandon any wait in progress.
@@ -66,8 +87,9 @@ struct t_kernel_impl {
     // a shutdown does not permanently disarm the object.
     std::atomic<bool> shutdown_requested{false};
 
-    // Execution counter of the cell currently waiting for a result, or 0 when
-    // no cell is waiting. Read by the main thread to stamp incoming results.
+    // Execution counter of the oldest cell waiting for a result, or 0 when no
+    // cell is waiting. Read by the main thread to stamp incoming results that
+    // do not name their cell.
     std::atomic<int> current_execution{0};
 
     // Number of cells queued or in flight. Maintained by the interpreter on
@@ -79,6 +101,39 @@ struct t_kernel_impl {
     // fire-and-forget: the cell returns as soon as the code reaches the outlet.
     std::atomic<long> timeout{30};
 
+    // Most cells handed to Max at once. 1 runs cells strictly one after
+    // another; above that, each cell carries its counter on the outlet and the
+    // patch names the cell it is answering with `cell <n> ...`.
+    std::atomic<long> concurrency{1};
+
+    // Hand the patch each cell split into typed atoms (@tokenize 1), rather
+    // than as one symbol.
+    std::atomic<bool> tokenize{false};
+
+    // Send `dict` results as JSON Patches against the dictionary's previous
+    // snapshot, with the whole document every dict_diff updates (@diff N).
+    // 0 or less sends the whole document every time.
+    std::atomic<long> dict_diff{0};
+
+    // Most bytes of stream text joined into one IOPub message. Consecutive
+    // `print`s for the same cell and stream are batched up to this size per
+    // server tick; 0 or less publishes every line on its own.
+    std::atomic<long> stream_batch_bytes{64 * 1024};
+
+    // IOPub rate limits for stream output, after Jupyter's
+    // iopub_msg_rate_limit and iopub_data_rate_limit: messages, after
+    // batching, and bytes per second, averaged over iopub_rate_window_ms.
+    // Output beyond either is dropped and summarised once per window on
+    // stderr. 0 disables a limit.
+    std::atomic<long> iopub_msg_rate_limit{1000};
+    std::atomic<long> iopub_data_rate_limit{1000000};
+    std::atomic<long> iopub_rate_window_ms{3000};
+
+    // Stream output dropped by the rate limits since the object was created.
+    // Written by the server thread, read by `info` on the main thread.
+    std::atomic<long long> suppressed_messages{0};
+    std::atomic<long long> suppressed_bytes{0};
+
     // Set by the kernel thread just before it returns, so the main thread can
     // wait for it with a deadline (std::thread has no timed join).
     std::atomic<bool> thread_finished{false};
@@ -88,12 +143,28 @@ struct t_kernel_impl {
     // freed, because the detached thread may still reference them.
     bool leaked = false;
 
+    // Kernel thread: an empty message, recycled if one is available.
+    OutletMessage make_outlet_message() {
+        if (auto spent = outlet_free.try_pop()) {
+            return std::move(*spent);
+        }
+        return OutletMessage{};
+    }
+
+    // Main thread: hand a delivered message back for reuse. If the free list
+    // is full the message is simply freed.
+    void recycle(OutletMessage&& msg) {
+        msg.clear();
+        (void)outlet_free.push(std::move(msg));
+    }
+
     // Wakes the main thread to drain outlet_queue. Set by the external to a
     // closure over qelem_set; cleared under m_notify_mutex during teardown so
     // the kernel thread cannot touch a freed qelem.
     void set_notifier(std::function<void()> fn) {
         std::lock_guard<std::mutex> lock(notify_mutex);
         notify = std::move(fn);
+        notify_pending.store(false);
     }
 
     void clear_notifier() {
@@ -101,15 +172,58 @@ struct t_kernel_impl {
         notify = nullptr;
     }
 
+    // Called after each push to outlet_queue. Only the first push since the
+    // last drain calls the notifier; the rest ride on the drain it schedules.
     void notify_main_thread() {
+        if (notify_pending.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
         std::lock_guard<std::mutex> lock(notify_mutex);
         if (notify) {
             notify();
+        } else {
+            // Nobody to tell. Stay re-armed for when somebody is.
+            notify_pending.store(false);
         }
     }
 
+    // Called by the drain before it takes the backlog. A push that lands after
+    // this schedules another drain, so nothing is left waiting; one that
+    // lands before it may schedule a drain that finds nothing, which is
+    // harmless. The exchange pairs with the one in notify_main_thread, so the
+    // drain sees every push whose notification it absorbs.
+    void clear_notify_pending() {
+        notify_pending.exchange(false, std::memory_order_acq_rel);
+    }
+
+    std::atomic<bool> notify_pending{false};
     std::mutex notify_mutex;
     std::function<void()> notify;
+
+    // Wakes the server loop, so queued results and output are handled now
+    // rather than at its next poll timeout. Set by the external to a closure
+    // over xserver_zmq::wake once the server exists, and cleared before the
+    // server is destroyed -- under its own mutex, for the same reason as the
+    // notifier: `print` may arrive from the scheduler thread mid-teardown.
+    void set_server_waker(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(waker_mutex);
+        server_waker = std::move(fn);
+    }
+
+    void clear_server_waker() {
+        std::lock_guard<std::mutex> lock(waker_mutex);
+        server_waker = nullptr;
+    }
+
+    void wake_server() {
+        std::lock_guard<std::mutex> lock(waker_mutex);
+        if (server_waker) {
+            server_waker();
+        }
+    }
+
+    std::mutex waker_mutex;
+    std::function<void()> server_waker;
 };
 
 } // namespace mx